@@ -2,6 +2,17 @@
 // The swift-tools-version declares the minimum version of Swift required to build this package.
 
 import PackageDescription
+import Foundation
+
+// lzlib is linked from /usr/local/lib, or from LZLIB_PREFIX when set, e.g. to the
+// tuned build made by `make lzlib-tuned`. The headers are always the ones in
+// Sources/lzlib, so Lzip.libraryVersion tells which library was actually loaded.
+let lzlibLinkerFlags: [String] = {
+    guard let prefix = ProcessInfo.processInfo.environment["LZLIB_PREFIX"] else {
+        return ["-L/usr/local/lib/"]
+    }
+    return ["-L\(prefix)/lib", "-Xlinker", "-rpath", "-Xlinker", "\(prefix)/lib"]
+}()
 
 let package = Package(
     name: "LzSwift",
@@ -12,7 +23,7 @@ let package = Package(
         .target(name: "LzSwift",
                 dependencies: ["lzlib"],
                 linkerSettings: [
-                    .unsafeFlags(["-L/usr/local/lib/"])
+                    .unsafeFlags(lzlibLinkerFlags)
                 ]
         ),
         .systemLibrary(
@@ -24,6 +35,9 @@ let package = Package(
                 .apt(["lzlib-dev"]),
             ]
         ),
+        // Counts the benchmark process's own allocations; never linked into the library
+        .target(name: "LzSwiftHeapCounters"),
+        .target(name: "LzSwiftBenchmarks", dependencies: ["LzSwift", "LzSwiftHeapCounters"]),
         
         .testTarget(name: "LzSwiftTests", dependencies: ["LzSwift"]),
     ],
@@ -4,7 +4,12 @@ import lzlib
 public enum Lzip { }
 
 extension Lzip {
-    public enum CompressionLevel {
+    /// Version of the lzlib actually linked, which may differ from the headers built against
+    public static var libraryVersion: String {
+        return String(cString: LZ_version())
+    }
+    
+    public enum CompressionLevel: CaseIterable {
         case lvl0
         case lvl1
         case lvl2
@@ -24,17 +29,69 @@ extension Data {
     }
 
     public func lzipped(level: Lzip.CompressionLevel) throws -> Data? {
-        let compressor = Lzip.Compress(level: level)
-        var destination = Data(capacity: self.count * 4)
+        let parameters = Lzip.Parameters(level: level, inputSize: self.count)
+        return try Lzip.Pool.shared.withCompressor(parameters: parameters) { compressor -> Data? in
+            var destination = Data(capacity: Lzip.maxCompressedSize(for: self.count))
+            try compressor.compress(input: self,
+                                    output: &destination)
+            try compressor.finish(output: &destination)
+            return destination
+        }
+    }
+    
+    public func lzipped(level: Lzip.CompressionLevel,
+                        threads: Int,
+                        blockSize: Int? = nil) throws -> Data? {
+        let compressor = Lzip.ParallelCompress(level: level,
+                                               blockSize: blockSize,
+                                               threads: threads)
+        let members = max((self.count + compressor.blockSize - 1) / compressor.blockSize, 1)
+        var destination = Data(capacity: Lzip.maxCompressedSize(for: self.count, members: members))
         try compressor.compress(input: self,
                                 output: &destination)
-        compressor.finish(output: &destination)
         return destination
     }
     
     public func lunzipped() throws -> Data? {
-        let decompressor = Lzip.Decompress()
-        var destination = Data(capacity: self.count / 2)
+        // The member trailers record the exact decompressed size, so a well formed
+        // stream is decoded straight into a single allocation of the right size,
+        // as long as that size is plausible for the input
+        let index = try? Lzip.Index(self)
+        if let index = index, index.dataSize <= index.reservableDataSize {
+            var destination = Data(count: index.dataSize)
+            do {
+                let count = try self.withUnsafeBytes { (input: UnsafeRawBufferPointer) in
+                    try destination.withUnsafeMutableBytes { (output: UnsafeMutableRawBufferPointer) in
+                        try Lzip.Pool.shared.withDecompressor { decompressor in
+                            try decompressor.decompress(input: input,
+                                                        into: output)
+                        }
+                    }
+                }
+                guard count == index.dataSize else { throw Lzip.Error(LZ_data_error) }
+            } catch let error as Lzip.Error where error.kind == .overflow {
+                // More data than the trailers claim
+                throw Lzip.Error(LZ_data_error)
+            }
+            return destination
+        }
+        
+        // Unindexable input, e.g. with trailing data, or trailers claiming more than
+        // can be reserved; grow as we go. Truncation throws.
+        return try Lzip.Pool.shared.withDecompressor { decompressor -> Data? in
+            var destination = Data(capacity: index?.reservableDataSize ?? self.count / 2)
+            try self.withUnsafeBytes { (input: UnsafeRawBufferPointer) -> Void in
+                try decompressor.decompress(input: input, options: .default) { chunk in
+                    destination.append(chunk.bindMemory(to: UInt8.self))
+                }
+            }
+            return destination
+        }
+    }
+    
+    public func lunzipped(threads: Int) throws -> Data? {
+        let decompressor = Lzip.ParallelDecompress(threads: threads)
+        var destination = Data()
         try decompressor.decompress(input: self,
                                     output: &destination)
         return destination
@@ -0,0 +1,307 @@
+import Foundation
+import lzlib
+
+extension Lzip {
+    /// Multi-file container stored as an ordinary multimember .lz stream.
+    ///
+    /// The decompressed stream is the contents of every entry back to back followed by
+    /// a JSON directory of paths, offsets and sizes. Small files are grouped into
+    /// shared members of about `memberSize` bytes, so they share one dictionary setup
+    /// and compress against each other; a file never straddles two members unless it is
+    /// larger than `memberSize` itself. The directory is always the last member on its
+    /// own, so a reader finds it through the member index and then decodes only the
+    /// members holding the entry it wants. `lzip -d` still unpacks the raw stream.
+    public enum Archive {
+        public struct Entry: Codable, Equatable {
+            public let path: String
+            /// Offset of the entry's contents in the decompressed stream
+            public let offset: Int
+            public let size: Int
+        }
+        
+        /// A file to be archived, loaded only when its member is compressed
+        public struct Source {
+            public let path: String
+            public let size: Int
+            let load: () throws -> Data
+            
+            public init(path: String,
+                        contents: Data) {
+                self.path = path
+                self.size = contents.count
+                self.load = { contents }
+            }
+            
+            /// Reads the file at `url` through a mapping when it is compressed
+            public init(path: String,
+                        contentsOf url: URL) throws {
+                let attributes = try FileManager.default.attributesOfItem(atPath: url.path)
+                self.path = path
+                self.size = (attributes[.size] as? NSNumber)?.intValue ?? 0
+                self.load = { try Data(contentsOf: url, options: .alwaysMapped) }
+            }
+        }
+        
+        struct Directory: Codable {
+            let format: String
+            let entries: [Entry]
+        }
+        
+        static let format = "LzSwift archive 1"
+        
+        /// A stretch of one source's contents going into a member
+        private struct Piece {
+            let source: Int
+            let range: Range<Int>
+        }
+        
+        /// Compresses `sources` into an archive, handing every member to `sink` in order.
+        /// Members are compressed in parallel, a wave of `threads * 4` at a time, so only
+        /// a bounded number of finished members is held in memory. Keep similar files next
+        /// to each other in `sources` for the best ratio. Throws `.argument` if two
+        /// sources have the same path.
+        public static func write(_ sources: [Source],
+                                 level: CompressionLevel,
+                                 memberSize: Int = 1 << 20,
+                                 threads: Int = ProcessInfo.processInfo.activeProcessorCount,
+                                 sink: (UnsafeRawBufferPointer) throws -> Void) throws {
+            let memberSize = max(memberSize, Int(LZ_min_dictionary_size()))
+            let threads = max(threads, 1)
+            guard Set(sources.map { $0.path }).count == sources.count else {
+                throw Lzip.Error(kind: .argument)
+            }
+            
+            var entries = [Entry]()
+            var plan = [[Piece]]()
+            var member = [Piece]()
+            var memberFill = 0
+            var offset = 0
+            for (sourceIdx, source) in sources.enumerated() {
+                entries.append(Entry(path: source.path, offset: offset, size: source.size))
+                offset += source.size
+                
+                // Start a new member rather than split a file that fits in one
+                if memberFill > 0 && memberFill + source.size > memberSize {
+                    plan.append(member)
+                    member = []
+                    memberFill = 0
+                }
+                var position = 0
+                while position < source.size {
+                    let count = min(source.size - position, memberSize - memberFill)
+                    member.append(Piece(source: sourceIdx, range: position..<position + count))
+                    memberFill += count
+                    position += count
+                    if memberFill == memberSize {
+                        plan.append(member)
+                        member = []
+                        memberFill = 0
+                    }
+                }
+            }
+            if member.isEmpty == false {
+                plan.append(member)
+            }
+            
+            let waveSize = threads * 4
+            var firstMember = 0
+            while firstMember < plan.count {
+                let wave = plan[firstMember..<min(firstMember + waveSize, plan.count)]
+                for member in try compressWave(wave, sources: sources, level: level, threads: threads) {
+                    try member.withUnsafeBytes { (bytes: UnsafeRawBufferPointer) in
+                        try sink(bytes)
+                    }
+                }
+                firstMember = wave.endIndex
+            }
+            
+            let directory = try JSONEncoder().encode(Directory(format: format, entries: entries))
+            let directoryMember = try directory.withUnsafeBytes { (bytes: UnsafeRawBufferPointer) in
+                try Lzip.compressMember(bytes, level: level)
+            }
+            try directoryMember.withUnsafeBytes { (bytes: UnsafeRawBufferPointer) in
+                try sink(bytes)
+            }
+        }
+        
+        public static func create(_ sources: [Source],
+                                  level: CompressionLevel,
+                                  memberSize: Int = 1 << 20,
+                                  threads: Int = ProcessInfo.processInfo.activeProcessorCount) throws -> Data {
+            var output = Data()
+            try write(sources, level: level, memberSize: memberSize, threads: threads) { member in
+                output.append(member.bindMemory(to: UInt8.self))
+            }
+            return output
+        }
+        
+        /// Archives every regular file under `directory` into `destination`, with paths
+        /// relative to `directory`. Files are ordered by extension and then path, so that
+        /// files of the same kind end up sharing members.
+        public static func create(directory: URL,
+                                  at destination: URL,
+                                  level: CompressionLevel,
+                                  memberSize: Int = 1 << 20,
+                                  threads: Int = ProcessInfo.processInfo.activeProcessorCount) throws {
+            let root = directory.standardizedFileURL.resolvingSymlinksInPath()
+            guard let enumerator = FileManager.default.enumerator(at: root,
+                                                                  includingPropertiesForKeys: [.isRegularFileKey]) else {
+                throw Lzip.Error(kind: .argument)
+            }
+            
+            var files = [(path: String, url: URL)]()
+            for case let url as URL in enumerator {
+                guard try url.resourceValues(forKeys: [.isRegularFileKey]).isRegularFile == true else { continue }
+                let components = url.standardizedFileURL.pathComponents.dropFirst(root.pathComponents.count)
+                files.append((path: components.joined(separator: "/"), url: url))
+            }
+            files.sort { ($0.url.pathExtension, $0.path) < ($1.url.pathExtension, $1.path) }
+            
+            let sources = try files.map { try Source(path: $0.path, contentsOf: $0.url) }
+            let output = try FileWriter(url: destination)
+            try write(sources, level: level, memberSize: memberSize, threads: threads, sink: output.append)
+            try output.flush()
+        }
+        
+        private static func compressWave(_ wave: ArraySlice<[Piece]>,
+                                         sources: [Source],
+                                         level: CompressionLevel,
+                                         threads: Int) throws -> [Data] {
+            var members = [Data](repeating: Data(), count: wave.count)
+            try members.withUnsafeMutableBufferPointer { slots in
+                try Lzip.parallelForEach(count: wave.count, threads: threads) { slot in
+                    let pieces = wave[wave.startIndex + slot]
+                    var input = Data(capacity: pieces.reduce(0) { $0 + $1.range.count })
+                    for piece in pieces {
+                        let contents = try sources[piece.source].load()
+                        guard contents.count >= piece.range.upperBound else {
+                            // The file shrank since it was listed
+                            throw Lzip.Error(LZ_unexpected_eof)
+                        }
+                        input.append(contents[(contents.startIndex + piece.range.lowerBound)..<(contents.startIndex + piece.range.upperBound)])
+                    }
+                    slots[slot] = try input.withUnsafeBytes { (bytes: UnsafeRawBufferPointer) in
+                        try Lzip.compressMember(bytes, level: level)
+                    }
+                }
+            }
+            return members
+        }
+    }
+    
+    /// Reads entries out of an `Archive`, decoding only the members that hold them.
+    public final class ArchiveReader {
+        public let entries: [Archive.Entry]
+        
+        private let reader: SeekableReader
+        private let entryIndices: [String: Int]
+        
+        public convenience init(data: Data) throws {
+            try self.init(reader: try SeekableReader(data: data))
+        }
+        
+        /// Maps the archive at `url`; see `SeekableReader` for `cacheIndex`
+        public convenience init(contentsOf url: URL,
+                                cacheIndex: Bool = false) throws {
+            try self.init(reader: try SeekableReader(contentsOf: url, cacheIndex: cacheIndex))
+        }
+        
+        init(reader: SeekableReader) throws {
+            self.reader = reader
+            
+            guard let last = reader.index.members.last,
+                  let directory = try? JSONDecoder().decode(Archive.Directory.self,
+                                                            from: reader.read(offset: last.dataOffset, length: last.dataSize)),
+                  directory.format == Archive.format,
+                  directory.entries.allSatisfy({ $0.offset >= 0 && $0.size >= 0 && $0.size <= last.dataOffset - $0.offset }) else {
+                throw Lzip.Error(kind: .header)
+            }
+            self.entries = directory.entries
+            
+            var entryIndices = [String: Int]()
+            for (entryIdx, entry) in directory.entries.enumerated() {
+                guard entryIndices.updateValue(entryIdx, forKey: entry.path) == nil else {
+                    // Extracting would write the same file twice
+                    throw Lzip.Error(kind: .header)
+                }
+            }
+            self.entryIndices = entryIndices
+        }
+        
+        public func entry(at path: String) -> Archive.Entry? {
+            return entryIndices[path].map { entries[$0] }
+        }
+        
+        public func contents(of entry: Archive.Entry) throws -> Data {
+            return try reader.read(offset: entry.offset, length: entry.size)
+        }
+        
+        /// Contents of the entry at `path`, or nil if there is none
+        public func contents(at path: String) throws -> Data? {
+            return try entry(at: path).map { try contents(of: $0) }
+        }
+        
+        /// Writes every entry below `directory`, decoding each member once. Throws
+        /// `.argument` for an entry whose path would leave `directory`.
+        public func extract(to directory: URL) throws {
+            let targets = try entries.map { entry -> URL in
+                let components = entry.path.split(separator: "/")
+                guard components.isEmpty == false,
+                      entry.path.hasPrefix("/") == false,
+                      components.allSatisfy({ $0 != ".." && $0 != "." }) else {
+                    throw Lzip.Error(kind: .argument)
+                }
+                return components.reduce(directory) { $0.appendingPathComponent(String($1)) }
+            }
+            
+            var writers = [Int: FileWriter]()
+            func writer(for entryIdx: Int) throws -> FileWriter {
+                if let writer = writers[entryIdx] {
+                    return writer
+                }
+                try FileManager.default.createDirectory(at: targets[entryIdx].deletingLastPathComponent(),
+                                                        withIntermediateDirectories: true)
+                let writer = try FileWriter(url: targets[entryIdx])
+                writers[entryIdx] = writer
+                return writer
+            }
+            
+            for entryIdx in entries.indices where entries[entryIdx].size == 0 {
+                try writer(for: entryIdx).flush()
+                writers[entryIdx] = nil
+            }
+            
+            // Entries sorted by offset, so each member only has to look at the next few
+            let order = entries.indices.filter { entries[$0].size > 0 }.sorted { entries[$0].offset < entries[$1].offset }
+            var first = 0
+            for member in reader.index.members.dropLast() {
+                let memberEnd = member.dataOffset + member.dataSize
+                guard first < order.count else { break }
+                guard entries[order[first]].offset < memberEnd else { continue }
+                
+                let data = try reader.read(offset: member.dataOffset, length: member.dataSize)
+                var position = first
+                while position < order.count && entries[order[position]].offset < memberEnd {
+                    let entryIdx = order[position]
+                    let entry = entries[entryIdx]
+                    let start = max(entry.offset, member.dataOffset)
+                    let end = min(entry.offset + entry.size, memberEnd)
+                    if start < end {
+                        let writer = try writer(for: entryIdx)
+                        try data.withUnsafeBytes { (bytes: UnsafeRawBufferPointer) in
+                            try writer.append(UnsafeRawBufferPointer(rebasing: bytes[(start - member.dataOffset)..<(end - member.dataOffset)]))
+                        }
+                    }
+                    if entry.offset + entry.size <= memberEnd {
+                        try writers[entryIdx]?.flush()
+                        writers[entryIdx] = nil
+                        if position == first {
+                            first += 1
+                        }
+                    }
+                    position += 1
+                }
+            }
+        }
+    }
+}
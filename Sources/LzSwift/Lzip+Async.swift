@@ -0,0 +1,175 @@
+#if compiler(>=5.5) && canImport(_Concurrency)
+import Foundation
+import lzlib
+
+extension Lzip {
+    /// Compresses an upstream sequence of byte chunks into a sequence of lzip chunks.
+    ///
+    /// Work is driven by the consumer: the upstream is only pulled for more input once
+    /// the previous output has been taken, so a slow consumer throttles the producer
+    /// and nothing beyond one chunk is ever buffered.
+    @available(macOS 10.15, iOS 13.0, tvOS 13.0, watchOS 6.0, *)
+    public struct AsyncCompressSequence<Base: AsyncSequence>: AsyncSequence where Base.Element: ContiguousBytes {
+        public typealias Element = Data
+        
+        let base: Base
+        let level: CompressionLevel
+        
+        public struct AsyncIterator: AsyncIteratorProtocol {
+            var base: Base.AsyncIterator
+            var compressor: Compress?
+            
+            public mutating func next() async throws -> Data? {
+                while let compressor = compressor {
+                    // Sized for a full read buffer, so a typical chunk is a single allocation
+                    var output = Data(capacity: compressor.buffer.capacity)
+                    do {
+                        guard let chunk = try await base.next() else {
+                            try compressor.finish { bytes in
+                                output.append(bytes.bindMemory(to: UInt8.self))
+                            }
+                            self.compressor = nil
+                            Pool.shared.recycle(compressor)
+                            return output
+                        }
+                        try chunk.withUnsafeBytes { (input: UnsafeRawBufferPointer) -> Void in
+                            try compressor.compress(input: input) { bytes in
+                                output.append(bytes.bindMemory(to: UInt8.self))
+                            }
+                        }
+                    } catch {
+                        self.compressor = nil
+                        throw error
+                    }
+                    if output.isEmpty == false {
+                        return output
+                    }
+                }
+                return nil
+            }
+        }
+        
+        public func makeAsyncIterator() -> AsyncIterator {
+            return AsyncIterator(base: base.makeAsyncIterator(),
+                                 compressor: Pool.shared.compressor(level: level))
+        }
+    }
+    
+    /// Decompresses an upstream sequence of lzip chunks into a sequence of byte chunks,
+    /// pulling from the upstream only as fast as the output is consumed.
+    @available(macOS 10.15, iOS 13.0, tvOS 13.0, watchOS 6.0, *)
+    public struct AsyncDecompressSequence<Base: AsyncSequence>: AsyncSequence where Base.Element: ContiguousBytes {
+        public typealias Element = Data
+        
+        let base: Base
+        
+        public struct AsyncIterator: AsyncIteratorProtocol {
+            var base: Base.AsyncIterator
+            var decompressor: Decompress?
+            
+            public mutating func next() async throws -> Data? {
+                while let decompressor = decompressor {
+                    var output = Data(capacity: decompressor.buffer.capacity)
+                    do {
+                        guard let chunk = try await base.next() else {
+                            try decompressor.finish { bytes in
+                                output.append(bytes.bindMemory(to: UInt8.self))
+                            }
+                            self.decompressor = nil
+                            Pool.shared.recycle(decompressor)
+                            return output.isEmpty ? nil : output
+                        }
+                        try chunk.withUnsafeBytes { (input: UnsafeRawBufferPointer) -> Void in
+                            try decompressor.decompress(input: input) { bytes in
+                                output.append(bytes.bindMemory(to: UInt8.self))
+                            }
+                        }
+                    } catch {
+                        self.decompressor = nil
+                        throw error
+                    }
+                    if output.isEmpty == false {
+                        return output
+                    }
+                }
+                return nil
+            }
+        }
+        
+        public func makeAsyncIterator() -> AsyncIterator {
+            return AsyncIterator(base: base.makeAsyncIterator(),
+                                 decompressor: Pool.shared.decompressor())
+        }
+    }
+}
+
+@available(macOS 10.15, iOS 13.0, tvOS 13.0, watchOS 6.0, *)
+extension Lzip.ParallelCompress {
+    /// Compresses `input` into a multimember stream on a task group instead of
+    /// blocking threads of the cooperative pool for the whole job. At most `threads`
+    /// blocks are in flight at a time, so pick fewer than the number of cores to
+    /// leave room for other tasks; each child task holds a thread for one block.
+    ///
+    /// Cancellation is checked between blocks and throws CancellationError. After
+    /// every block, in input order, `progress` is called with the input and output
+    /// bytes so far; `memberPosition` is always 0.
+    public func compress(input: Data,
+                         progress: ((Lzip.Progress) -> Void)? = nil) async throws -> Data {
+        let blockCount = max((input.count + blockSize - 1) / blockSize, 1)
+        let start = DispatchTime.now().uptimeNanoseconds
+        var output = Data(capacity: Lzip.maxCompressedSize(for: input.count, members: blockCount))
+        var totalIn = 0
+        
+        try await withThrowingTaskGroup(of: (Int, Data).self) { group -> Void in
+            var nextBlock = 0
+            func addBlock() {
+                let block = nextBlock
+                nextBlock += 1
+                group.addTask {
+                    try Task.checkCancellation()
+                    let member = try input.withUnsafeBytes { (bytes: UnsafeRawBufferPointer) in
+                        try self.compressBlock(input: bytes, block: block)
+                    }
+                    return (block, member)
+                }
+            }
+            
+            while nextBlock < min(threads, blockCount) {
+                addBlock()
+            }
+            
+            // Members can finish out of order; hold them until their turn comes
+            var finished = [Int: Data]()
+            var nextMember = 0
+            while let (block, member) = try await group.next() {
+                try Task.checkCancellation()
+                finished[block] = member
+                while let ready = finished.removeValue(forKey: nextMember) {
+                    output.append(ready)
+                    totalIn += min(blockSize, input.count - nextMember * blockSize)
+                    nextMember += 1
+                    progress?(Lzip.Progress(totalIn: totalIn,
+                                            totalOut: output.count,
+                                            memberPosition: 0,
+                                            elapsed: TimeInterval(DispatchTime.now().uptimeNanoseconds - start) / 1e9))
+                }
+                if nextBlock < blockCount {
+                    addBlock()
+                }
+            }
+        }
+        return output
+    }
+}
+
+@available(macOS 10.15, iOS 13.0, tvOS 13.0, watchOS 6.0, *)
+extension AsyncSequence where Element: ContiguousBytes {
+    public func lzipped(level: Lzip.CompressionLevel) -> Lzip.AsyncCompressSequence<Self> {
+        return Lzip.AsyncCompressSequence(base: self, level: level)
+    }
+    
+    public func lunzipped() -> Lzip.AsyncDecompressSequence<Self> {
+        return Lzip.AsyncDecompressSequence(base: self)
+    }
+}
+#endif
@@ -0,0 +1,136 @@
+import Foundation
+import lzlib
+
+extension Lzip {
+    /// Parallel compressor that picks the level as it goes to meet a speed or time goal,
+    /// instead of a fixed level that is either too slow for the job or leaves ratio on
+    /// the table.
+    ///
+    /// The input is compressed in waves of one block per thread with `ParallelCompress`.
+    /// After each wave the measured throughput (input bytes over wall time) is compared
+    /// with the rate the goal needs: a wave that was too slow moves the next one to a
+    /// faster level, and one with enough headroom tries the next slower, denser level.
+    /// Rates are remembered per level, so a level that was already too slow is not
+    /// tried again unless the requirement drops. The levels stand for their dictionary
+    /// size and match length limit, and every block is still an ordinary member.
+    public final class AutoTune {
+        public enum Goal {
+            /// Best ratio that still compresses at least this many MB (10^6 bytes) per second
+            case throughput(mbPerSecond: Double)
+            /// Best ratio that still compresses the whole input within this many seconds
+            case deadline(TimeInterval)
+        }
+        
+        /// One wave of blocks, all compressed at `level`
+        public struct Step {
+            public let level: CompressionLevel
+            public let inputSize: Int
+            public let outputSize: Int
+            public let seconds: TimeInterval
+            
+            public var mbPerSecond: Double {
+                return seconds > 0 ? Double(inputSize) / seconds / 1e6 : .infinity
+            }
+        }
+        
+        public let goal: Goal
+        public let initialLevel: CompressionLevel
+        public let blockSize: Int
+        public let threads: Int
+        /// How much faster than needed a level must run before a slower one is tried
+        public let headroom: Double
+        
+        public init(goal: Goal,
+                    initialLevel: CompressionLevel = .lvl6,
+                    blockSize: Int = 4 << 20,
+                    threads: Int = ProcessInfo.processInfo.activeProcessorCount,
+                    headroom: Double = 1.5) {
+            self.goal = goal
+            self.initialLevel = initialLevel
+            self.blockSize = max(blockSize, Int(LZ_min_dictionary_size()))
+            self.threads = max(threads, 1)
+            self.headroom = max(headroom, 1)
+        }
+        
+        /// Compresses `input`, handing every member to `sink` in input order, and
+        /// returns the level used for each wave.
+        @discardableResult
+        public func compress(input: UnsafeRawBufferPointer,
+                             sink: (UnsafeRawBufferPointer) throws -> Void) throws -> [Step] {
+            let levels = CompressionLevel.allCases
+            var levelIdx = levels.firstIndex(of: initialLevel) ?? 0
+            var rates = [Double?](repeating: nil, count: levels.count)
+            var steps = [Step]()
+            let waveSize = blockSize * threads
+            let start = DispatchTime.now().uptimeNanoseconds
+            
+            var offset = 0
+            repeat {
+                let end = min(offset + waveSize, input.count)
+                let compressor = ParallelCompress(level: levels[levelIdx], blockSize: blockSize, threads: threads)
+                let waveStart = DispatchTime.now().uptimeNanoseconds
+                var outputSize = 0
+                try compressor.compress(input: UnsafeRawBufferPointer(rebasing: input[offset..<end])) { member in
+                    outputSize += member.count
+                    try sink(member)
+                }
+                let now = DispatchTime.now().uptimeNanoseconds
+                let step = Step(level: levels[levelIdx],
+                                inputSize: end - offset,
+                                outputSize: outputSize,
+                                seconds: TimeInterval(now - waveStart) / 1e9)
+                steps.append(step)
+                offset = end
+                
+                // Smooth out noise from short waves
+                let previous = rates[levelIdx] ?? step.mbPerSecond
+                rates[levelIdx] = (previous + step.mbPerSecond) / 2
+                let required = requiredRate(remaining: input.count - offset,
+                                            elapsed: TimeInterval(now - start) / 1e9)
+                levelIdx = nextLevel(after: levelIdx, rates: rates, required: required)
+            } while offset < input.count
+            
+            return steps
+        }
+        
+        @discardableResult
+        public func compress(input: Data,
+                             output: inout Data) throws -> [Step] {
+            return try input.withUnsafeBytes { (inBuffer: UnsafeRawBufferPointer) -> [Step] in
+                try compress(input: inBuffer) { member in
+                    output.append(member.bindMemory(to: UInt8.self))
+                }
+            }
+        }
+        
+        /// MB/s the rest of the input has to be compressed at
+        private func requiredRate(remaining: Int,
+                                  elapsed: TimeInterval) -> Double {
+            switch goal {
+            case .throughput(let mbPerSecond):
+                return mbPerSecond
+            case .deadline(let seconds):
+                let left = seconds - elapsed
+                return left > 0 ? Double(remaining) / left / 1e6 : .infinity
+            }
+        }
+        
+        private func nextLevel(after levelIdx: Int,
+                               rates: [Double?],
+                               required: Double) -> Int {
+            guard let rate = rates[levelIdx] else { return levelIdx }
+            
+            if rate < required {
+                // The densest faster level known to be fast enough, otherwise one step
+                return (0..<levelIdx).last { (rates[$0] ?? 0) >= required } ?? max(levelIdx - 1, 0)
+            }
+            
+            let slower = levelIdx + 1
+            guard slower < rates.count else { return levelIdx }
+            if let known = rates[slower] {
+                return known >= required ? slower : levelIdx
+            }
+            return rate >= required * headroom ? slower : levelIdx
+        }
+    }
+}
@@ -0,0 +1,120 @@
+import Foundation
+import lzlib
+
+extension Lzip {
+    /// Compressed outputs of a batch, packed back to back into a single allocation.
+    /// Each element is a complete single-member .lz stream.
+    public struct Batch: RandomAccessCollection {
+        /// All outputs, in input order
+        public let storage: Data
+        /// Range of each output within `storage`
+        public let ranges: [Range<Int>]
+        
+        public var startIndex: Int {
+            return ranges.startIndex
+        }
+        
+        public var endIndex: Int {
+            return ranges.endIndex
+        }
+        
+        /// The compressed output for input `position`. This is a slice sharing the
+        /// arena's storage, so its indices start at `ranges[position].lowerBound`.
+        public subscript(position: Int) -> Data {
+            return storage[ranges[position]]
+        }
+    }
+    
+    /// Compresses every element of `inputs` as its own single-member stream.
+    ///
+    /// Meant for large numbers of small records, where setting up a context costs more
+    /// than the compression itself: the records are split into contiguous runs that
+    /// worker threads claim in turn, and each run goes through one pooled compressor,
+    /// its dictionary capped to the run's largest record, that is only restarted
+    /// between records. All outputs are written straight into one arena sized from
+    /// `maxCompressedSize`, then packed together in place. A record that still does not
+    /// fit its slot is compressed again into a buffer of its own.
+    public static func compress(batch inputs: [Data],
+                                level: CompressionLevel,
+                                threads: Int = ProcessInfo.processInfo.activeProcessorCount) throws -> Batch {
+        // Every record gets a worst-case slot in the arena, so workers never overlap
+        var slots = [Int](repeating: 0, count: inputs.count + 1)
+        for (i, input) in inputs.enumerated() {
+            slots[i + 1] = slots[i] + maxCompressedSize(for: input.count)
+        }
+        
+        var storage = Data(count: slots[inputs.count])
+        var sizes = [Int](repeating: 0, count: inputs.count)
+        var overflows = [Int: Data]()
+        
+        let workers = min(max(threads, 1), inputs.count)
+        // A few runs per worker keeps them busy when record sizes are uneven
+        let runCount = min(workers * 4, inputs.count)
+        let lock = NSLock()
+        
+        try storage.withUnsafeMutableBytes { (arena: UnsafeMutableRawBufferPointer) -> Void in
+            try sizes.withUnsafeMutableBufferPointer { sizes in
+                try parallelForEach(count: runCount, threads: workers) { run in
+                    let records = (run * inputs.count / runCount)..<((run + 1) * inputs.count / runCount)
+                    let largest = records.map { inputs[$0].count }.max() ?? 0
+                    try Pool.shared.withCompressor(parameters: Parameters(level: level, inputSize: largest)) { compressor in
+                        for record in records {
+                            try compressor.reset()
+                            let slot = UnsafeMutableRawBufferPointer(rebasing: arena[slots[record]..<slots[record + 1]])
+                            do {
+                                sizes[record] = try inputs[record].withUnsafeBytes { (input: UnsafeRawBufferPointer) in
+                                    try compressor.compress(input: input, into: slot)
+                                }
+                            } catch let error as Lzip.Error where error.kind == .overflow {
+                                try compressor.reset()
+                                let member = try inputs[record].withUnsafeBytes { (input: UnsafeRawBufferPointer) in
+                                    try compressor.compressMember(input)
+                                }
+                                sizes[record] = member.count
+                                lock.lock()
+                                overflows[record] = member
+                                lock.unlock()
+                            }
+                        }
+                    }
+                }
+            }
+        }
+        
+        var ranges = [Range<Int>]()
+        ranges.reserveCapacity(inputs.count)
+        var packed = 0
+        
+        // Outputs that overflowed their slots make the packed result larger than some
+        // prefix of the arena, so they are gathered into fresh storage instead
+        if overflows.isEmpty == false {
+            var gathered = Data(capacity: sizes.reduce(0, +))
+            for record in 0..<inputs.count {
+                if let member = overflows[record] {
+                    gathered.append(member)
+                } else {
+                    gathered.append(storage[slots[record]..<(slots[record] + sizes[record])])
+                }
+                ranges.append(packed..<(packed + sizes[record]))
+                packed += sizes[record]
+            }
+            return Batch(storage: gathered, ranges: ranges)
+        }
+        
+        // Pack the outputs down over the unused tail of each slot. Outputs only ever
+        // move towards the front, so a forward pass of memmoves is safe.
+        storage.withUnsafeMutableBytes { (arena: UnsafeMutableRawBufferPointer) -> Void in
+            guard let base = arena.baseAddress else { return }
+            for record in 0..<inputs.count {
+                if packed != slots[record] {
+                    memmove(base + packed, base + slots[record], sizes[record])
+                }
+                ranges.append(packed..<(packed + sizes[record]))
+                packed += sizes[record]
+            }
+        }
+        storage.count = packed
+        
+        return Batch(storage: storage, ranges: ranges)
+    }
+}
@@ -0,0 +1,59 @@
+import Foundation
+import lzlib
+
+extension Lzip {
+    /// Size of the scratch buffer a context reads its output through. Larger chunks
+    /// mean fewer LZ_*_read calls and sink callbacks on big streams.
+    public enum BufferSize {
+        case fixed(Int)
+        /// Starts at `initial` and doubles, up to `maximum`, whenever a read fills
+        /// the whole buffer, i.e. while output keeps arriving faster than it is read
+        case adaptive(initial: Int, maximum: Int)
+        
+        public static let `default` = BufferSize.adaptive(initial: 16384, maximum: 1024 * 1024)
+    }
+    
+    final class ReadBuffer {
+        private(set) var pointer: UnsafeMutablePointer<UInt8>
+        private(set) var capacity: Int
+        /// `capacity` as lzlib's read size, converted once rather than on every read
+        private(set) var readSize: Int32
+        let maximum: Int
+        
+        init(_ size: BufferSize) {
+            let initial: Int
+            switch size {
+            case .fixed(let size):
+                initial = max(size, 1)
+                maximum = initial
+            case .adaptive(let start, let limit):
+                initial = max(start, 1)
+                maximum = max(limit, initial)
+            }
+            capacity = initial
+            readSize = Int32(clamping: initial)
+            pointer = UnsafeMutablePointer<UInt8>.allocate(capacity: initial)
+        }
+        
+        deinit {
+            pointer.deallocate()
+        }
+        
+        /// Reports how many bytes the last read produced. Must not be called while a
+        /// chunk of the buffer is still handed out.
+        @inline(__always)
+        func didRead(_ count: Int) {
+            if count == capacity && capacity < maximum {
+                grow()
+            }
+        }
+        
+        private func grow() {
+            let newCapacity = min(capacity * 2, maximum)
+            pointer.deallocate()
+            pointer = UnsafeMutablePointer<UInt8>.allocate(capacity: newCapacity)
+            capacity = newCapacity
+            readSize = Int32(clamping: newCapacity)
+        }
+    }
+}
@@ -1,98 +1,319 @@
 import Foundation
 import lzlib
 
-fileprivate let bufferSize = 16384
+extension Lzip.CompressionLevel {
+    var dictionarySize: Int32 {
+        switch self {
+        case .lvl0: return 65535
+        case .lvl1: return 1 << 20
+        case .lvl2: return 1 << 19
+        case .lvl3: return 1 << 21
+        case .lvl4: return 1 << 20
+        case .lvl5: return 1 << 22
+        case .lvl6: return 1 << 23
+        case .lvl7: return 1 << 24
+        case .lvl8: return 1 << 23
+        case .lvl9: return 1 << 25
+        }
+    }
+    
+    var matchLenLimit: Int32 {
+        switch self {
+        case .lvl0: return 16
+        case .lvl1: return 5
+        case .lvl2: return 6
+        case .lvl3: return 8
+        case .lvl4: return 12
+        case .lvl5: return 20
+        case .lvl6: return 36
+        case .lvl7: return 68
+        case .lvl8: return 132
+        case .lvl9: return 273
+        }
+    }
+}
 
 extension Lzip {
+    /// Encoder settings: the dictionary size and match length limit that a
+    /// CompressionLevel otherwise picks from a fixed table.
+    public struct Parameters: Hashable {
+        public let dictionarySize: Int
+        public let matchLenLimit: Int
+        /// The level these were derived from, if any. Not part of equality; the pool
+        /// uses it to apply its idle limit per level.
+        let level: CompressionLevel?
+        
+        /// Throws `.argument` unless both values are within lzlib's limits,
+        /// LZ_min/max_dictionary_size and LZ_min/max_match_len_limit.
+        public init(dictionarySize: Int, matchLenLimit: Int) throws {
+            guard (Int(LZ_min_dictionary_size())...Int(LZ_max_dictionary_size())).contains(dictionarySize),
+                  (Int(LZ_min_match_len_limit())...Int(LZ_max_match_len_limit())).contains(matchLenLimit) else {
+                throw Lzip.Error(kind: .argument)
+            }
+            self.dictionarySize = dictionarySize
+            self.matchLenLimit = matchLenLimit
+            self.level = nil
+        }
+        
+        public init(level: CompressionLevel) {
+            dictionarySize = Int(level.dictionarySize)
+            matchLenLimit = Int(level.matchLenLimit)
+            self.level = level
+        }
+        
+        /// Dictionary sizes an input-capped level is rounded up to
+        private static let dictionaryBuckets = [64 << 10, 1 << 20, 8 << 20]
+        
+        /// The parameters of `level`, with the dictionary capped for an input of
+        /// `inputSize` bytes. A dictionary larger than the input is never used, so it
+        /// is shrunk to the first of 64 KiB, 1 MiB or 8 MiB that holds the input. That
+        /// leaves at most four sizes per level, so pooled encoders are reused across
+        /// inputs of mixed sizes. lvl0 is left alone, lzlib only selects its fast
+        /// encoder for that exact size.
+        public init(level: CompressionLevel, inputSize: Int) {
+            var dictionarySize = Int(level.dictionarySize)
+            if level != .lvl0,
+               let bucket = Parameters.dictionaryBuckets.first(where: { $0 >= inputSize }) {
+                dictionarySize = min(bucket, dictionarySize)
+            }
+            self.dictionarySize = dictionarySize
+            matchLenLimit = Int(level.matchLenLimit)
+            self.level = level
+        }
+        
+        public static func == (lhs: Parameters, rhs: Parameters) -> Bool {
+            return lhs.dictionarySize == rhs.dictionarySize && lhs.matchLenLimit == rhs.matchLenLimit
+        }
+        
+        public func hash(into hasher: inout Hasher) {
+            hasher.combine(dictionarySize)
+            hasher.combine(matchLenLimit)
+        }
+    }
+    
+    /// Practical upper bound on the compressed size of `count` bytes split into
+    /// `members` members, for sizing output buffers: 1/32 on top of the input plus the
+    /// 36 byte header and trailer of every member. LZMA has no stored mode, so
+    /// incompressible input expands, by well under 1/32 with lzlib's adaptive models,
+    /// but there is no tight provable bound for it. Code compressing into a buffer of
+    /// this size must handle `.overflow`, as `compress(batch:)` does.
+    public static func maxCompressedSize(for count: Int, members: Int = 1) -> Int {
+        return count + count / 32 + 36 * max(members, 1) + 64
+    }
+    
+    /// Compresses `input` as one member with a pooled compressor. Like plzip, the
+    /// dictionary is never larger than the input needs.
+    static func compressMember(_ input: UnsafeRawBufferPointer,
+                               level: CompressionLevel) throws -> Data {
+        return try Pool.shared.withCompressor(parameters: Parameters(level: level, inputSize: input.count)) { compressor in
+            try compressor.compressMember(input)
+        }
+    }
+    
     public class Compress {
-        let buffer = UnsafeMutablePointer<UInt8>.allocate(capacity: bufferSize)
+        let buffer: ReadBuffer
         var encoder: OpaquePointer?
+        var isPristine = true
+        var progress: ProgressTracker?
+        
+        public let parameters: Parameters
+        
+        /// Rough heap footprint; lzlib's encoder needs about 11x the dictionary size
+        var memoryFootprint: Int {
+            return 11 * parameters.dictionarySize + buffer.capacity
+        }
         
         deinit {
-            buffer.deallocate()
+            LZ_compress_close(encoder)
         }
         
-        init(level: CompressionLevel) {
-            var dicationarySize: Int32 = 65535
-            var matchLenLimit: Int32 = 16
-            
-            switch level {
-            case .lvl0:
-                dicationarySize = 65535
-                matchLenLimit = 16
-            case .lvl1:
-                dicationarySize = 1 << 20
-                matchLenLimit = 5
-            case .lvl2:
-                dicationarySize = 1 << 19
-                matchLenLimit = 6
-            case .lvl3:
-                dicationarySize = 1 << 21
-                matchLenLimit = 8
-            case .lvl4:
-                dicationarySize = 1 << 20
-                matchLenLimit = 12
-            case .lvl5:
-                dicationarySize = 1 << 22
-                matchLenLimit = 20
-            case .lvl6:
-                dicationarySize = 1 << 23
-                matchLenLimit = 36
-            case .lvl7:
-                dicationarySize = 1 << 24
-                matchLenLimit = 68
-            case .lvl8:
-                dicationarySize = 1 << 23
-                matchLenLimit = 132
-            case .lvl9:
-                dicationarySize = 1 << 25
-                matchLenLimit = 273
+        public convenience init(level: CompressionLevel,
+                                bufferSize: BufferSize = .default) {
+            self.init(parameters: Parameters(level: level),
+                      bufferSize: bufferSize)
+        }
+        
+        public init(parameters: Parameters,
+                    bufferSize: BufferSize = .default) {
+            self.buffer = ReadBuffer(bufferSize)
+            self.parameters = parameters
+            encoder = LZ_compress_open(Int32(parameters.dictionarySize),
+                                       Int32(parameters.matchLenLimit),
+                                       UInt64.max)
+        }
+        
+        /// Readies the context for a new, independent stream. The encoder and its
+        /// dictionary stay allocated, which is much cheaper than opening a new one.
+        /// A member still in progress is abandoned.
+        public func reset() throws {
+            if isPristine {
+                return
+            }
+            if LZ_compress_member_finished(encoder) != 1 {
+                LZ_compress_finish(encoder)
+                _ = try compressRead { _ in }
+            }
+            if LZ_compress_restart_member(encoder, UInt64.max) < 0 {
+                throw Lzip.Error(LZ_compress_errno(encoder))
             }
+            progress?.restart(totalIn: LZ_compress_total_in_size(encoder),
+                              totalOut: LZ_compress_total_out_size(encoder))
+            isPristine = true
+        }
+        
+        @inline(__always)
+        private func compressWrite(input: UnsafeRawBufferPointer,
+                                   drain: () throws -> Void) throws {
+            guard let inBuffer = input.baseAddress?.assumingMemoryBound(to: UInt8.self) else { return }
+            let inBufferSize = input.count
+            isPristine = false
+            var inOffset = 0
             
-            encoder = LZ_compress_open(dicationarySize, matchLenLimit, UInt64.max)
+            while inOffset < inBufferSize {
+                let inMaxSize = min(inBufferSize - inOffset, Int(LZ_compress_write_size(encoder)))
+                if inMaxSize > 0 {
+                    let wr = LZ_compress_write(encoder, inBuffer + inOffset, Int32(truncatingIfNeeded: inMaxSize))
+                    if wr < 0 {
+                        throw Lzip.Error(LZ_compress_errno(encoder))
+                    }
+                    inOffset += Int(wr)
+                    progress?.didWrite(Int(wr))
+                }
+                try drain()
+                if progress?.isDue == true {
+                    try reportProgress()
+                }
+            }
         }
         
-        private func compressRead(output: inout Data) throws {
+        @inline(__always)
+        private func compressRead(sink: (UnsafeRawBufferPointer) throws -> Void) throws -> Int {
+            var count = 0
             while true {
-                let rd = LZ_compress_read(encoder, buffer, Int32(bufferSize))
+                let rd = LZ_compress_read(encoder, buffer.pointer, buffer.readSize)
                 if rd < 0 {
-                    LZ_compress_close(encoder)
                     throw Lzip.Error(LZ_compress_errno(encoder))
                 }
                 if rd == 0 {
                     break
                 }
-                output.append(buffer, count: Int(rd))
-            }
-        }
-                
-        func compress(input: Data,
-                      output: inout Data) throws {
-            try input.withUnsafeBytes { (inBuffer: UnsafePointer<UInt8>) -> Void in
-                let inBufferSize = input.count
-                var inOffset = 0
-                
-                while inOffset < inBufferSize {
-                    let inMaxSize = min(inBufferSize - inOffset, Int(LZ_compress_write_size(encoder)))
-                    if inMaxSize > 0 {
-                        let wr = LZ_compress_write(encoder, inBuffer + inOffset, Int32(inMaxSize))
-                        if wr < 0 {
-                            LZ_compress_close(encoder)
-                            throw Lzip.Error(LZ_compress_errno(encoder))
-                        }
-                        inOffset += Int(wr)
+                try sink(UnsafeRawBufferPointer(start: buffer.pointer, count: Int(rd)))
+                count += Int(rd)
+                buffer.didRead(Int(rd))
+            }
+            return count
+        }
+        
+        private func compressRead(into output: UnsafeMutableRawBufferPointer,
+                                  at outOffset: inout Int) throws {
+            while true {
+                guard let outBuffer = output.baseAddress, outOffset < output.count else {
+                    // Out of room, which is only an error if the encoder still has output pending
+                    let rd = LZ_compress_read(encoder, buffer.pointer, 1)
+                    if rd < 0 {
+                        throw Lzip.Error(LZ_compress_errno(encoder))
+                    }
+                    if rd > 0 {
+                        throw Lzip.Error(kind: .overflow)
                     }
-                    try compressRead(output: &output)
+                    return
                 }
+                let rd = LZ_compress_read(encoder,
+                                          outBuffer.assumingMemoryBound(to: UInt8.self) + outOffset,
+                                          Int32(clamping: output.count - outOffset))
+                if rd < 0 {
+                    throw Lzip.Error(LZ_compress_errno(encoder))
+                }
+                if rd == 0 {
+                    break
+                }
+                outOffset += Int(rd)
             }
         }
         
-        func finish(output: inout Data) {
+        /// Compresses `input`, handing each chunk of compressed output to `sink` as soon
+        /// as it is produced. The chunk is only valid for the duration of the call.
+        /// Returns the number of compressed bytes produced.
+        @discardableResult
+        public func compress(input: UnsafeRawBufferPointer,
+                             sink: (UnsafeRawBufferPointer) throws -> Void) throws -> Int {
+            var count = 0
+            try compressWrite(input: input) {
+                count += try compressRead(sink: sink)
+            }
+            return count
+        }
+        
+        /// Ends the member, handing the remaining compressed output to `sink`.
+        @discardableResult
+        public func finish(sink: (UnsafeRawBufferPointer) throws -> Void) throws -> Int {
+            isPristine = false
             LZ_compress_finish(encoder)
-            
-            try? compressRead(output: &output)
-            
-            LZ_compress_close(encoder)
+            let count = try compressRead(sink: sink)
+            try reportProgress()
+            return count
+        }
+        
+        /// Makes everything written so far available as output without ending the member,
+        /// handing it to `sink`, so the other side can decode each record as soon as it is
+        /// written while the dictionary carries over to the next. Every flush adds a few
+        /// bytes of sync markers, so use it per message, not per byte. The resulting stream
+        /// is meant for lzlib peers; sync flush markers are not allowed in .lz files.
+        @discardableResult
+        public func flush(sink: (UnsafeRawBufferPointer) throws -> Void) throws -> Int {
+            isPristine = false
+            if LZ_compress_sync_flush(encoder) < 0 {
+                throw Lzip.Error(LZ_compress_errno(encoder))
+            }
+            return try compressRead(sink: sink)
+        }
+        
+        /// Compresses all of `input` as a complete member written straight into `output`,
+        /// returning the number of bytes written. Throws `.overflow` if it does not fit.
+        public func compress(input: UnsafeRawBufferPointer,
+                             into output: UnsafeMutableRawBufferPointer) throws -> Int {
+            var outOffset = 0
+            try compressWrite(input: input) {
+                try compressRead(into: output, at: &outOffset)
+            }
+            isPristine = false
+            LZ_compress_finish(encoder)
+            try compressRead(into: output, at: &outOffset)
+            try reportProgress()
+            return outOffset
+        }
+        
+        public func compress(input: Data,
+                             output: inout Data) throws {
+            try input.withUnsafeBytes { (inBuffer: UnsafeRawBufferPointer) -> Void in
+                try compress(input: inBuffer) { chunk in
+                    output.append(chunk.bindMemory(to: UInt8.self))
+                }
+            }
+        }
+        
+        public func flush(output: inout Data) throws {
+            try flush { chunk in
+                output.append(chunk.bindMemory(to: UInt8.self))
+            }
+        }
+        
+        public func finish(output: inout Data) throws {
+            try finish { chunk in
+                output.append(chunk.bindMemory(to: UInt8.self))
+            }
+        }
+        
+        /// Compresses all of `input` as one complete member of its own
+        func compressMember(_ input: UnsafeRawBufferPointer) throws -> Data {
+            var member = Data(capacity: Lzip.maxCompressedSize(for: input.count))
+            try compress(input: input) { chunk in
+                member.append(chunk.bindMemory(to: UInt8.self))
+            }
+            try finish { chunk in
+                member.append(chunk.bindMemory(to: UInt8.self))
+            }
+            return member
         }
     }
 }
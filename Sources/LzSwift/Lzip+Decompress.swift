@@ -1,58 +1,164 @@
 import Foundation
 import lzlib
 
-fileprivate let bufferSize = 16384
-
 extension Lzip {
     public class Decompress {
-        let buffer = UnsafeMutablePointer<UInt8>.allocate(capacity: bufferSize)
+        let buffer: ReadBuffer
         var decoder: OpaquePointer?
+        var progress: ProgressTracker?
         
         deinit {
-            buffer.deallocate()
+            LZ_decompress_close(decoder)
         }
         
-        init() {
+        public init(bufferSize: BufferSize = .default) {
+            buffer = ReadBuffer(bufferSize)
             decoder = LZ_decompress_open()
         }
-                
-        @discardableResult
-        func decompress(input: Data,
-                        output: inout Data) throws -> Bool {
-            try input.withUnsafeBytes { (inBuffer: UnsafePointer<UInt8>) -> Void in
-                let inBufferSize = input.count
-                var inOffset = 0
-                
-                while inOffset < inBufferSize {
-                    let inMaxSize = min(inBufferSize - inOffset, Int(LZ_decompress_write_size(decoder)))
-                    if inMaxSize > 0 {
-                        let wr = LZ_decompress_write(decoder, inBuffer + inOffset, Int32(inMaxSize))
-                        if wr < 0 {
-                            LZ_decompress_close(decoder)
-                            throw Lzip.Error(LZ_decompress_errno(decoder))
-                        }
-                        inOffset += Int(wr)
+        
+        /// Readies the context for a new, independent stream, discarding any input
+        /// and output still buffered.
+        public func reset() throws {
+            if LZ_decompress_reset(decoder) < 0 {
+                throw Lzip.Error(LZ_decompress_errno(decoder))
+            }
+            progress?.restart(totalIn: LZ_decompress_total_in_size(decoder),
+                              totalOut: LZ_decompress_total_out_size(decoder))
+        }
+        
+        /// Rough heap footprint of an idle context; member dictionaries are released on reset
+        var memoryFootprint: Int {
+            return 64 * 1024 + buffer.capacity
+        }
+        
+        /// True once every member written so far has been decoded and read and the
+        /// end of the stream has been signalled with `finish`.
+        public var isFinished: Bool {
+            return LZ_decompress_finished(decoder) == 1
+        }
+        
+        @inline(__always)
+        private func decompressWrite(input: UnsafeRawBufferPointer,
+                                     drain: () throws -> Void) throws {
+            guard let inBuffer = input.baseAddress?.assumingMemoryBound(to: UInt8.self) else { return }
+            let inBufferSize = input.count
+            var inOffset = 0
+            
+            while inOffset < inBufferSize {
+                let inMaxSize = min(inBufferSize - inOffset, Int(LZ_decompress_write_size(decoder)))
+                if inMaxSize > 0 {
+                    let wr = LZ_decompress_write(decoder, inBuffer + inOffset, Int32(truncatingIfNeeded: inMaxSize))
+                    if wr < 0 {
+                        throw Lzip.Error(LZ_decompress_errno(decoder))
                     }
-                    
-                    while true {
-                        let rd = LZ_decompress_read(decoder, buffer, Int32(bufferSize))
-                        if rd < 0 {
-                            LZ_decompress_close(decoder)
-                            throw Lzip.Error(LZ_decompress_errno(decoder))
-                        }
-                        if rd == 0 {
-                            break
-                        }
-                        output.append(buffer, count: Int(rd))
+                    inOffset += Int(wr)
+                    progress?.didWrite(Int(wr))
+                }
+                try drain()
+                if progress?.isDue == true {
+                    try reportProgress()
+                }
+            }
+        }
+        
+        @inline(__always)
+        private func decompressRead(sink: (UnsafeRawBufferPointer) throws -> Void) throws -> Int {
+            var count = 0
+            while true {
+                let rd = LZ_decompress_read(decoder, buffer.pointer, buffer.readSize)
+                if rd < 0 {
+                    throw Lzip.Error(LZ_decompress_errno(decoder))
+                }
+                if rd == 0 {
+                    break
+                }
+                try sink(UnsafeRawBufferPointer(start: buffer.pointer, count: Int(rd)))
+                count += Int(rd)
+                buffer.didRead(Int(rd))
+            }
+            return count
+        }
+        
+        private func decompressRead(into output: UnsafeMutableRawBufferPointer,
+                                    at outOffset: inout Int) throws {
+            while true {
+                guard let outBuffer = output.baseAddress, outOffset < output.count else {
+                    // Out of room, which is only an error if the decoder still has output pending
+                    let rd = LZ_decompress_read(decoder, buffer.pointer, 1)
+                    if rd < 0 {
+                        throw Lzip.Error(LZ_decompress_errno(decoder))
                     }
+                    if rd > 0 {
+                        throw Lzip.Error(kind: .overflow)
+                    }
+                    return
+                }
+                let rd = LZ_decompress_read(decoder,
+                                            outBuffer.assumingMemoryBound(to: UInt8.self) + outOffset,
+                                            Int32(clamping: output.count - outOffset))
+                if rd < 0 {
+                    throw Lzip.Error(LZ_decompress_errno(decoder))
+                }
+                if rd == 0 {
+                    break
                 }
+                outOffset += Int(rd)
             }
-            
-            if LZ_decompress_finished(decoder) == 1 {
-                LZ_decompress_close(decoder)
-                return true
+        }
+        
+        /// Decompresses `input`, handing each chunk of decompressed output to `sink` as
+        /// soon as it is produced. The chunk is only valid for the duration of the call.
+        /// Returns the number of decompressed bytes produced.
+        @discardableResult
+        public func decompress(input: UnsafeRawBufferPointer,
+                               sink: (UnsafeRawBufferPointer) throws -> Void) throws -> Int {
+            var count = 0
+            try decompressWrite(input: input) {
+                count += try decompressRead(sink: sink)
+            }
+            return count
+        }
+        
+        /// Signals the end of the compressed stream, handing the remaining output to
+        /// `sink`. Throws `.eof` if the stream was truncated.
+        @discardableResult
+        public func finish(sink: (UnsafeRawBufferPointer) throws -> Void) throws -> Int {
+            LZ_decompress_finish(decoder)
+            let count = try decompressRead(sink: sink)
+            guard isFinished else {
+                throw Lzip.Error(LZ_unexpected_eof)
+            }
+            try reportProgress()
+            return count
+        }
+        
+        /// Decodes all of `input` as a complete stream written straight into `output`,
+        /// returning the number of bytes written. Throws `.overflow` if it does not fit
+        /// and `.eof` if the stream is truncated.
+        public func decompress(input: UnsafeRawBufferPointer,
+                               into output: UnsafeMutableRawBufferPointer) throws -> Int {
+            var outOffset = 0
+            try decompressWrite(input: input) {
+                try decompressRead(into: output, at: &outOffset)
+            }
+            LZ_decompress_finish(decoder)
+            try decompressRead(into: output, at: &outOffset)
+            guard isFinished else {
+                throw Lzip.Error(LZ_unexpected_eof)
+            }
+            try reportProgress()
+            return outOffset
+        }
+        
+        @discardableResult
+        public func decompress(input: Data,
+                               output: inout Data) throws -> Bool {
+            try input.withUnsafeBytes { (inBuffer: UnsafeRawBufferPointer) -> Void in
+                try decompress(input: inBuffer) { chunk in
+                    output.append(chunk.bindMemory(to: UInt8.self))
+                }
             }
-            return false
+            return isFinished
         }
     }
 }
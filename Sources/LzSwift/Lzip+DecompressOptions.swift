@@ -0,0 +1,220 @@
+import Foundation
+import lzlib
+
+fileprivate let magic: [UInt8] = [0x4c, 0x5a, 0x49, 0x50]
+
+extension Lzip.Decompress {
+    /// How a whole stream is decoded by `decompress(input:options:sink:)`
+    public struct Options {
+        public enum TrailingData {
+            /// Stop quietly at data following the last member, as the lzip tools do
+            /// by default. Data that looks like a corrupt member header is still an error.
+            case ignore
+            /// Throw `.header` on any data following the last member
+            case error
+        }
+        
+        /// Decode every member of a concatenated stream, or stop after the first
+        public var multimember: Bool
+        public var trailingData: TrailingData
+        /// Skip corrupt stretches with LZ_decompress_sync_to_member and carry on with
+        /// the next member, instead of throwing. The corrupt member's output up to the
+        /// error has already been handed out and the rest of it is lost.
+        public var recover: Bool
+        /// Stop once this many bytes have been produced, without decoding the rest
+        public var outputLimit: Int?
+        /// Throw `.limit` on a member whose header declares a larger dictionary. The
+        /// header is checked in the input before lzlib reads it, so the dictionary is
+        /// never allocated; this is what bounds a decoder's memory on untrusted input.
+        public var dictionaryLimit: Int?
+        /// Throw `.limit` instead of producing more than this many bytes, to guard
+        /// against decompression bombs. Unlike `outputLimit`, the output is an error.
+        public var maxOutputSize: Int?
+        
+        public init(multimember: Bool = true,
+                    trailingData: TrailingData = .ignore,
+                    recover: Bool = false,
+                    outputLimit: Int? = nil,
+                    dictionaryLimit: Int? = nil,
+                    maxOutputSize: Int? = nil) {
+            self.multimember = multimember
+            self.trailingData = trailingData
+            self.recover = recover
+            self.outputLimit = outputLimit
+            self.dictionaryLimit = dictionaryLimit
+            self.maxOutputSize = maxOutputSize
+        }
+        
+        public static let `default` = Options()
+    }
+    
+    /// What `decompress(input:options:sink:)` did
+    public struct Outcome {
+        public enum Stop {
+            /// The whole input was decoded, up to any ignored trailing data
+            case finished
+            /// `multimember` was false and the first member is complete
+            case firstMember
+            /// `outputLimit` was reached
+            case outputLimit
+        }
+        
+        public let stop: Stop
+        /// Members fully decoded
+        public let members: Int
+        public let outputSize: Int
+        /// Compressed bytes decoded
+        public let inputSize: Int
+        /// Bytes following the last member that were ignored
+        public let trailingSize: Int
+        /// Corrupt stretches skipped with `recover`
+        public let recoveries: Int
+    }
+    
+    /// Decodes `input` as a complete stream, finish included, handing each chunk of
+    /// output to `sink`, with `options` deciding what to do with concatenated members,
+    /// trailing data and corruption, and when to stop early. Throws `.eof` if the
+    /// stream is truncated.
+    @discardableResult
+    public func decompress(input: UnsafeRawBufferPointer,
+                           options: Options,
+                           sink: (UnsafeRawBufferPointer) throws -> Void) throws -> Outcome {
+        var inOffset = 0
+        var inputFinished = false
+        var members = 0
+        var memberFinished = false
+        // Input offset just past the last finished member. Once a header fails to
+        // parse lzlib has already counted the bytes it tried, so the total in size
+        // no longer tells where the trailing data starts.
+        var memberEnd = 0
+        var outputSize = 0
+        var recoveries = 0
+        
+        func outcome(_ stop: Outcome.Stop, inputSize: Int? = nil, trailingSize: Int = 0) -> Outcome {
+            return Outcome(stop: stop,
+                           members: members,
+                           outputSize: outputSize,
+                           inputSize: inputSize ?? Int(LZ_decompress_total_in_size(decoder)),
+                           trailingSize: trailingSize,
+                           recoveries: recoveries)
+        }
+        
+        // Members start at the beginning of the input and right after a finished one
+        func checkHeader(at offset: Int) throws {
+            guard let limit = options.dictionaryLimit,
+                  let header = Lzip.Index.parseHeader(input, at: offset) else { return }
+            if header.dictionarySize > limit {
+                throw Lzip.Error(kind: .limit)
+            }
+        }
+        try checkHeader(at: 0)
+        
+        while true {
+            if let inBuffer = input.baseAddress?.assumingMemoryBound(to: UInt8.self), inOffset < input.count {
+                let inMaxSize = min(input.count - inOffset, Int(LZ_decompress_write_size(decoder)))
+                if inMaxSize > 0 {
+                    let wr = LZ_decompress_write(decoder, inBuffer + inOffset, Int32(truncatingIfNeeded: inMaxSize))
+                    if wr < 0 {
+                        throw Lzip.Error(LZ_decompress_errno(decoder))
+                    }
+                    inOffset += Int(wr)
+                    progress?.didWrite(Int(wr))
+                }
+                if progress?.isDue == true {
+                    try reportProgress()
+                }
+            } else if inputFinished == false {
+                LZ_decompress_finish(decoder)
+                inputFinished = true
+            }
+            
+            while true {
+                let rd = LZ_decompress_read(decoder, buffer.pointer, buffer.readSize)
+                if rd < 0 {
+                    let code = LZ_decompress_errno(decoder)
+                    
+                    // Anything that fails to parse as a header right after a complete
+                    // member is trailing data
+                    if members > 0 && memberFinished && (code == LZ_header_error || code == LZ_unexpected_eof) {
+                        let trailingSize = max(input.count - memberEnd, 0)
+                        let trailing = input.suffix(trailingSize).prefix(magic.count)
+                        if options.trailingData == .error || (trailing.isEmpty == false && trailing.elementsEqual(magic.prefix(trailing.count))) {
+                            throw Lzip.Error(LZ_header_error)
+                        }
+                        return outcome(.finished, inputSize: memberEnd, trailingSize: trailingSize)
+                    }
+                    
+                    if options.recover && (code == LZ_data_error || code == LZ_header_error) {
+                        if LZ_decompress_sync_to_member(decoder) < 0 {
+                            throw Lzip.Error(LZ_decompress_errno(decoder))
+                        }
+                        recoveries += 1
+                        memberFinished = false
+                        continue
+                    }
+                    throw Lzip.Error(code)
+                }
+                
+                // Covers members found by recovery, whose start is not known up front
+                if let limit = options.dictionaryLimit, Int(LZ_decompress_dictionary_size(decoder)) > limit {
+                    throw Lzip.Error(kind: .limit)
+                }
+                
+                if rd > 0 {
+                    let count = min(Int(rd), (options.outputLimit ?? Int.max) - outputSize)
+                    if let limit = options.maxOutputSize, outputSize + count > limit {
+                        throw Lzip.Error(kind: .limit)
+                    }
+                    if count > 0 {
+                        try sink(UnsafeRawBufferPointer(start: buffer.pointer, count: count))
+                        outputSize += count
+                    }
+                    buffer.didRead(Int(rd))
+                    if let limit = options.outputLimit, outputSize >= limit {
+                        return outcome(.outputLimit)
+                    }
+                }
+                
+                let finished = LZ_decompress_member_finished(decoder) == 1
+                if finished && memberFinished == false {
+                    members += 1
+                    memberEnd = Int(LZ_decompress_total_in_size(decoder))
+                    if options.multimember == false {
+                        return outcome(.firstMember)
+                    }
+                    try checkHeader(at: memberEnd)
+                }
+                memberFinished = finished
+                
+                if rd == 0 {
+                    break
+                }
+            }
+            
+            if inputFinished {
+                guard isFinished else {
+                    throw Lzip.Error(LZ_unexpected_eof)
+                }
+                try reportProgress()
+                return outcome(.finished)
+            }
+        }
+    }
+}
+
+extension Data {
+    /// Decompresses with explicit control over concatenated members, trailing data,
+    /// recovery and early termination, e.g. `Options(outputLimit: 1024)` to probe the
+    /// start of a large stream without decoding the rest.
+    public func lunzipped(options: Lzip.Decompress.Options) throws -> Data? {
+        return try Lzip.Pool.shared.withDecompressor { decompressor -> Data? in
+            var destination = Data(capacity: Swift.min(self.count, options.outputLimit ?? options.maxOutputSize ?? self.count))
+            try self.withUnsafeBytes { (input: UnsafeRawBufferPointer) -> Void in
+                try decompressor.decompress(input: input, options: options) { chunk in
+                    destination.append(chunk.bindMemory(to: UInt8.self))
+                }
+            }
+            return destination
+        }
+    }
+}
@@ -1,8 +1,6 @@
 import Foundation
 import lzlib
 
-fileprivate let bufferSize = 16384
-
 extension Lzip {
     public struct Error: Swift.Error {
         
@@ -15,10 +13,18 @@ extension Lzip {
             case eof
             case data
             case library
+            case overflow
+            case cancelled
+            /// A member exceeded a limit set in `Decompress.Options`
+            case limit
             case unknown
         }
         
         public let kind: Kind
+        
+        internal init(kind: Kind) {
+            self.kind = kind
+        }
                 
         internal init(_ code: LZ_Errno) {
             self.kind = {
@@ -26,7 +32,7 @@ extension Lzip {
                 case LZ_ok:
                     return .ok
                 case LZ_bad_argument:
-                    return .data
+                    return .argument
                 case LZ_mem_error:
                     return .memory
                 case LZ_sequence_error:
@@ -0,0 +1,184 @@
+import Foundation
+import lzlib
+
+fileprivate let writeChunkSize = 1024 * 1024
+
+func posixError() -> Swift.Error {
+    return POSIXError(POSIXErrorCode(rawValue: errno) ?? .EIO)
+}
+
+/// Writes all of `bytes` to `fd`, retrying short and interrupted writes
+func writeAll(_ fd: Int32, _ bytes: UnsafeRawBufferPointer) throws {
+    guard let base = bytes.baseAddress else { return }
+    var offset = 0
+    while offset < bytes.count {
+        let written = write(fd, base + offset, bytes.count - offset)
+        if written < 0 {
+            if errno == EINTR {
+                continue
+            }
+            throw posixError()
+        }
+        offset += written
+    }
+}
+
+extension Lzip {
+    /// Read-only memory mapping of a whole file. The bytes are only handed out inside
+    /// `withBytes`, which keeps the mapping alive for as long as they are used.
+    final class MappedFile {
+        private let bytes: UnsafeRawBufferPointer
+        
+        /// `advice` is the madvise hint for how the mapping will be accessed
+        init(url: URL, advice: Int32 = MADV_SEQUENTIAL) throws {
+            let fd = open(url.path, O_RDONLY)
+            guard fd >= 0 else { throw posixError() }
+            defer { close(fd) }
+            
+            var info = stat()
+            guard fstat(fd, &info) == 0 else { throw posixError() }
+            
+            let size = Int(info.st_size)
+            guard size > 0 else {
+                bytes = UnsafeRawBufferPointer(start: nil, count: 0)
+                return
+            }
+            
+            guard let base = mmap(nil, size, PROT_READ, MAP_PRIVATE, fd, 0),
+                  base != UnsafeMutableRawPointer(bitPattern: -1) else {
+                throw posixError()
+            }
+            _ = madvise(base, size, advice)
+            bytes = UnsafeRawBufferPointer(start: base, count: size)
+        }
+        
+        deinit {
+            if let base = bytes.baseAddress {
+                munmap(UnsafeMutableRawPointer(mutating: base), bytes.count)
+            }
+        }
+        
+        func withBytes<T>(_ body: (UnsafeRawBufferPointer) throws -> T) rethrows -> T {
+            return try withExtendedLifetime(self) {
+                try body(bytes)
+            }
+        }
+    }
+    
+    /// Streams output to a file descriptor, coalescing small chunks into large writes
+    final class FileWriter {
+        let fd: Int32
+        private let staging = UnsafeMutableRawBufferPointer.allocate(byteCount: writeChunkSize,
+                                                                     alignment: MemoryLayout<UInt64>.alignment)
+        private var staged = 0
+        
+        init(url: URL) throws {
+            // Read access too, so the parallel decoder can map the file shared
+            fd = open(url.path, O_RDWR | O_CREAT | O_TRUNC, 0o644)
+            guard fd >= 0 else { throw posixError() }
+        }
+        
+        deinit {
+            close(fd)
+            staging.deallocate()
+        }
+        
+        func append(_ chunk: UnsafeRawBufferPointer) throws {
+            if staged + chunk.count > staging.count {
+                try flush()
+            }
+            if chunk.count >= staging.count {
+                try writeAll(chunk)
+                return
+            }
+            UnsafeMutableRawBufferPointer(rebasing: staging[staged...]).copyMemory(from: chunk)
+            staged += chunk.count
+        }
+        
+        func flush() throws {
+            try writeAll(UnsafeRawBufferPointer(rebasing: staging[0..<staged]))
+            staged = 0
+        }
+        
+        private func writeAll(_ bytes: UnsafeRawBufferPointer) throws {
+            try LzSwift.writeAll(fd, bytes)
+        }
+    }
+    
+    /// Compresses the file at `source` into `destination`. The input is memory mapped
+    /// and fed to the encoder without copying, and the output is streamed to disk, so
+    /// neither has to fit in memory. With more than one thread the parallel
+    /// multimember compressor is used.
+    public static func compressFile(at source: URL,
+                                    to destination: URL,
+                                    level: CompressionLevel,
+                                    threads: Int = 1) throws {
+        let input = try MappedFile(url: source)
+        let output = try FileWriter(url: destination)
+        
+        try input.withBytes { (bytes: UnsafeRawBufferPointer) -> Void in
+            if threads > 1 {
+                let compressor = ParallelCompress(level: level, threads: threads)
+                try compressor.compress(input: bytes, sink: output.append)
+            } else {
+                let parameters = Parameters(level: level, inputSize: bytes.count)
+                try Pool.shared.withCompressor(parameters: parameters) { compressor in
+                    try compressor.compress(input: bytes, sink: output.append)
+                    try compressor.finish(sink: output.append)
+                }
+            }
+        }
+        try output.flush()
+    }
+    
+    /// Decompresses the file at `source` into `destination`. The input is memory mapped
+    /// and the output streamed to disk. With more than one thread, and an input whose
+    /// members can be indexed, the members are decoded in parallel straight into a
+    /// mapping of the output file.
+    public static func decompressFile(at source: URL,
+                                      to destination: URL,
+                                      threads: Int = 1) throws {
+        let input = try MappedFile(url: source)
+        let output = try FileWriter(url: destination)
+        
+        try input.withBytes { (bytes: UnsafeRawBufferPointer) -> Void in
+            // The output file is sized from the trailers up front, so only when that size
+            // is plausible for the input
+            if threads > 1,
+               let index = try? Index(bytes),
+               index.members.count > 1,
+               index.dataSize <= index.reservableDataSize {
+                try decompressMapped(input: bytes,
+                                     index: index,
+                                     fd: output.fd,
+                                     threads: threads)
+                return
+            }
+            
+            // Trailing data is ignored, as with Data.lunzipped()
+            try Pool.shared.withDecompressor { decompressor -> Void in
+                try decompressor.decompress(input: bytes, options: .default, sink: output.append)
+            }
+            try output.flush()
+        }
+    }
+    
+    private static func decompressMapped(input: UnsafeRawBufferPointer,
+                                         index: Index,
+                                         fd: Int32,
+                                         threads: Int) throws {
+        let size = index.dataSize
+        guard ftruncate(fd, off_t(size)) == 0 else { throw posixError() }
+        guard size > 0 else { return }
+        
+        guard let base = mmap(nil, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0),
+              base != UnsafeMutableRawPointer(bitPattern: -1) else {
+            throw posixError()
+        }
+        defer { munmap(base, size) }
+        
+        try ParallelDecompress(threads: threads).decompress(input: input,
+                                                            index: index,
+                                                            into: UnsafeMutableRawBufferPointer(start: base, count: size))
+    }
+}
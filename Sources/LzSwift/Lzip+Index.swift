@@ -0,0 +1,223 @@
+import Foundation
+import lzlib
+
+fileprivate let headerSize = 6
+fileprivate let trailerSize = 20
+fileprivate let minMemberSize = 36
+
+// LZMA cannot compress beyond roughly 7000:1, so a trailer claiming more is corrupt
+fileprivate let maxCompressionRatio: UInt64 = 8192
+
+// Up-front allocations are limited to this ratio over the compressed size, or
+// the floor, whichever is larger
+fileprivate let reservationRatio = 64
+fileprivate let reservationFloor = 64 << 20
+
+fileprivate func readLittleEndian(_ bytes: UnsafeRawBufferPointer, at offset: Int, count: Int) -> UInt64 {
+    var value: UInt64 = 0
+    for i in (0..<count).reversed() {
+        value = (value << 8) | UInt64(bytes[offset + i])
+    }
+    return value
+}
+
+extension Lzip {
+    public struct Member: Codable, Equatable {
+        /// Offset of the member header in the compressed stream
+        public let offset: Int
+        /// Size of the whole member, header and trailer included
+        public let size: Int
+        /// Offset of the member's data in the decompressed stream
+        public let dataOffset: Int
+        /// Size of the member's decompressed data
+        public let dataSize: Int
+        public let crc: UInt32
+        public let version: Int
+        public let dictionarySize: Int
+    }
+    
+    /// Member layout of a multimember lzip stream, recovered without decoding by
+    /// walking the 20-byte member trailers backwards from the end of the stream.
+    /// Only the headers and trailers are read, so this is a cheap way to learn a
+    /// stream's sizes and memory needs; the stream must not have trailing data.
+    public struct Index: Codable, Equatable {
+        public let members: [Member]
+        
+        /// Size of the whole decompressed stream
+        public var dataSize: Int {
+            guard let last = members.last else { return 0 }
+            return last.dataOffset + last.dataSize
+        }
+        
+        /// Size of the whole compressed stream
+        public var compressedSize: Int {
+            guard let last = members.last else { return 0 }
+            return last.offset + last.size
+        }
+        
+        /// How much of `dataSize` may be allocated before it is decoded. The trailers
+        /// are only checked as members are decoded and a ratio of up to 8192:1 is
+        /// accepted, so a few crafted MiB could otherwise demand tens of GiB up front;
+        /// beyond this, output grows as data is actually produced.
+        var reservableDataSize: Int {
+            return Index.reservable(dataSize: dataSize, compressedSize: compressedSize)
+        }
+        
+        /// How much of a claimed `dataSize` may be allocated up front for a stream of
+        /// `compressedSize` bytes; see `reservableDataSize`
+        static func reservable(dataSize: Int, compressedSize: Int) -> Int {
+            let (limit, overflow) = compressedSize.multipliedReportingOverflow(by: reservationRatio)
+            return max(min(dataSize, max(overflow ? Int.max : limit, reservationFloor)), 0)
+        }
+        
+        /// Largest dictionary any member declares, i.e. what a decoder has to allocate
+        public var dictionarySize: Int {
+            return members.lazy.map { $0.dictionarySize }.max() ?? 0
+        }
+        
+        /// Compressed size over decompressed size
+        public var ratio: Double {
+            return dataSize > 0 ? Double(compressedSize) / Double(dataSize) : 0
+        }
+        
+        /// Index of the member holding the decompressed byte at `position`
+        public func member(containing position: Int) -> Int? {
+            guard position >= 0, position < dataSize else { return nil }
+            var low = 0
+            var high = members.count - 1
+            while low < high {
+                let mid = (low + high + 1) / 2
+                if members[mid].dataOffset <= position {
+                    low = mid
+                } else {
+                    high = mid - 1
+                }
+            }
+            return low
+        }
+        
+        public init(_ data: Data) throws {
+            self = try data.withUnsafeBytes { (bytes: UnsafeRawBufferPointer) in
+                return try Index(bytes)
+            }
+        }
+        
+        /// Indexes the file at `url` through a memory mapping, so only the pages
+        /// holding headers and trailers are ever read.
+        public init(contentsOf url: URL) throws {
+            self = try MappedFile(url: url, advice: MADV_RANDOM).withBytes { (bytes: UnsafeRawBufferPointer) in
+                try Index(bytes)
+            }
+        }
+        
+        public init(_ bytes: UnsafeRawBufferPointer) throws {
+            var reversed = [(offset: Int, size: Int, dataSize: UInt64, crc: UInt32, version: Int, dictionarySize: Int)]()
+            
+            var position = bytes.count
+            while position > 0 {
+                guard position >= minMemberSize else { throw Lzip.Error(LZ_unexpected_eof) }
+                
+                let crc = UInt32(readLittleEndian(bytes, at: position - 20, count: 4))
+                let dataSize = readLittleEndian(bytes, at: position - 16, count: 8)
+                let memberSize = readLittleEndian(bytes, at: position - 8, count: 8)
+                
+                guard memberSize >= UInt64(minMemberSize),
+                      memberSize <= UInt64(position),
+                      dataSize / maxCompressionRatio <= memberSize else {
+                    throw Lzip.Error(LZ_data_error)
+                }
+                
+                let offset = position - Int(memberSize)
+                guard let header = Index.parseHeader(bytes, at: offset) else {
+                    throw Lzip.Error(LZ_header_error)
+                }
+                
+                reversed.append((offset: offset,
+                                 size: Int(memberSize),
+                                 dataSize: dataSize,
+                                 crc: crc,
+                                 version: header.version,
+                                 dictionarySize: header.dictionarySize))
+                position = offset
+            }
+            
+            guard reversed.isEmpty == false else { throw Lzip.Error(LZ_unexpected_eof) }
+            
+            var members = [Member]()
+            members.reserveCapacity(reversed.count)
+            
+            var dataOffset = 0
+            for member in reversed.reversed() {
+                guard member.dataSize <= UInt64(Int.max - dataOffset) else { throw Lzip.Error(LZ_data_error) }
+                members.append(Member(offset: member.offset,
+                                      size: member.size,
+                                      dataOffset: dataOffset,
+                                      dataSize: Int(member.dataSize),
+                                      crc: member.crc,
+                                      version: member.version,
+                                      dictionarySize: member.dictionarySize))
+                dataOffset += Int(member.dataSize)
+            }
+            self.members = members
+        }
+        
+        /// Cheap check that this index, e.g. one decoded from a cache, fits `bytes`:
+        /// members back to back from the start and within the stream, data offsets
+        /// following on from each other, and the last member's header and trailer
+        /// agreeing with it. Only the last member is read, so the other members are
+        /// trusted to match whatever the index was keyed on.
+        func describes(_ bytes: UnsafeRawBufferPointer) -> Bool {
+            guard let last = members.last else { return false }
+            
+            var offset = 0
+            var dataOffset = 0
+            for member in members {
+                guard member.offset == offset,
+                      member.dataOffset == dataOffset,
+                      member.size >= minMemberSize,
+                      member.size <= bytes.count - offset,
+                      member.dataSize >= 0,
+                      member.dataSize <= Int.max - dataOffset,
+                      UInt64(member.dataSize) / maxCompressionRatio <= UInt64(member.size) else {
+                    return false
+                }
+                offset += member.size
+                dataOffset += member.dataSize
+            }
+            guard offset == bytes.count,
+                  let header = Index.parseHeader(bytes, at: last.offset),
+                  header.version == last.version,
+                  header.dictionarySize == last.dictionarySize else {
+                return false
+            }
+            
+            let trailer = bytes.count - trailerSize
+            return UInt32(readLittleEndian(bytes, at: trailer, count: 4)) == last.crc &&
+                readLittleEndian(bytes, at: trailer + 4, count: 8) == UInt64(last.dataSize) &&
+                readLittleEndian(bytes, at: trailer + 12, count: 8) == UInt64(last.size)
+        }
+        
+        /// Version and dictionary size from the 6-byte member header at `offset`, or nil
+        /// if there is no valid header there. Only the header itself has to be present.
+        static func parseHeader(_ bytes: UnsafeRawBufferPointer, at offset: Int) -> (version: Int, dictionarySize: Int)? {
+            guard offset >= 0, bytes.count - offset >= headerSize else { return nil }
+            guard bytes[offset] == 0x4c,
+                  bytes[offset + 1] == 0x5a,
+                  bytes[offset + 2] == 0x49,
+                  bytes[offset + 3] == 0x50 else { return nil }
+            
+            let version = Int(bytes[offset + 4])
+            guard version == 1 else { return nil }
+            
+            let coded = bytes[offset + 5]
+            var dictionarySize = 1 << Int(coded & 0x1f)
+            if dictionarySize > Int(LZ_min_dictionary_size()) {
+                dictionarySize -= (dictionarySize / 16) * Int((coded >> 5) & 7)
+            }
+            guard dictionarySize >= Int(LZ_min_dictionary_size()),
+                  dictionarySize <= Int(LZ_max_dictionary_size()) else { return nil }
+            
+            return (version: version, dictionarySize: dictionarySize)
+        }
+    }
+}
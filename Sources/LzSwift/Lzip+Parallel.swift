@@ -0,0 +1,42 @@
+import Foundation
+import lzlib
+
+extension Lzip {
+    /// Calls `body` for every index in `0..<count` on up to `threads` workers, which
+    /// claim the indices in order, one at a time. After the first error no further
+    /// indices are handed out, and that error is rethrown once every worker is done.
+    static func parallelForEach(count: Int,
+                                threads: Int,
+                                body: (Int) throws -> Void) throws {
+        guard count > 0 else { return }
+        var next = 0
+        var failure: Swift.Error?
+        let lock = NSLock()
+        
+        DispatchQueue.concurrentPerform(iterations: min(max(threads, 1), count)) { _ in
+            while true {
+                lock.lock()
+                let index = next
+                next += 1
+                let done = index >= count || failure != nil
+                lock.unlock()
+                
+                if done {
+                    return
+                }
+                
+                do {
+                    try body(index)
+                } catch {
+                    lock.lock()
+                    failure = failure ?? error
+                    lock.unlock()
+                }
+            }
+        }
+        
+        if let failure = failure {
+            throw failure
+        }
+    }
+}
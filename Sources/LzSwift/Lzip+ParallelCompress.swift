@@ -0,0 +1,76 @@
+import Foundation
+import lzlib
+
+extension Lzip {
+    /// Multithreaded compressor in the style of plzip. The input is split into
+    /// fixed-size blocks, each block is compressed as an independent lzip member
+    /// on a pool of worker threads, and the members are written out in input
+    /// order, so the result is an ordinary multimember .lz stream.
+    public class ParallelCompress {
+        public let level: CompressionLevel
+        public let blockSize: Int
+        public let threads: Int
+        
+        /// plzip's default block size: twice the dictionary size, but at least 1 MiB
+        public static func defaultBlockSize(for level: CompressionLevel) -> Int {
+            return max(2 * Int(level.dictionarySize), 1 << 20)
+        }
+        
+        public init(level: CompressionLevel,
+                    blockSize: Int? = nil,
+                    threads: Int = ProcessInfo.processInfo.activeProcessorCount) {
+            self.level = level
+            self.blockSize = max(blockSize ?? ParallelCompress.defaultBlockSize(for: level),
+                                 Int(LZ_min_dictionary_size()))
+            self.threads = max(threads, 1)
+        }
+        
+        /// Compresses `input`, handing every finished member to `sink` in input order.
+        public func compress(input: UnsafeRawBufferPointer,
+                             sink: (UnsafeRawBufferPointer) throws -> Void) throws {
+            // An empty input still produces one (empty) member
+            let blockCount = max((input.count + blockSize - 1) / blockSize, 1)
+            
+            // Blocks are compressed in waves so that only a bounded number of
+            // finished members are held in memory before being written out
+            let waveSize = threads * 4
+            var firstBlock = 0
+            while firstBlock < blockCount {
+                let blocks = firstBlock..<min(firstBlock + waveSize, blockCount)
+                for member in try compressWave(input: input, blocks: blocks) {
+                    try member.withUnsafeBytes { (bytes: UnsafeRawBufferPointer) in
+                        try sink(bytes)
+                    }
+                }
+                firstBlock = blocks.upperBound
+            }
+        }
+        
+        public func compress(input: Data,
+                             output: inout Data) throws {
+            try input.withUnsafeBytes { (inBuffer: UnsafeRawBufferPointer) -> Void in
+                try compress(input: inBuffer) { member in
+                    output.append(member.bindMemory(to: UInt8.self))
+                }
+            }
+        }
+        
+        private func compressWave(input: UnsafeRawBufferPointer,
+                                  blocks: Range<Int>) throws -> [Data] {
+            var members = [Data](repeating: Data(), count: blocks.count)
+            try members.withUnsafeMutableBufferPointer { slots in
+                try Lzip.parallelForEach(count: blocks.count, threads: threads) { slot in
+                    slots[slot] = try compressBlock(input: input, block: blocks.lowerBound + slot)
+                }
+            }
+            return members
+        }
+        
+        func compressBlock(input: UnsafeRawBufferPointer,
+                           block: Int) throws -> Data {
+            let start = block * blockSize
+            let end = min(start + blockSize, input.count)
+            return try Lzip.compressMember(UnsafeRawBufferPointer(rebasing: input[start..<end]), level: level)
+        }
+    }
+}
@@ -0,0 +1,122 @@
+import Foundation
+import lzlib
+
+extension Lzip {
+    /// Multithreaded decompressor for multimember streams, such as those produced
+    /// by Lzip.ParallelCompress or plzip. Member boundaries and sizes are read from
+    /// the member trailers, the output is sized up front, and every member is
+    /// decoded on its own thread directly into its slice of the output.
+    ///
+    /// Streams that cannot be indexed (a single member, trailing data, a truncated
+    /// tail) are decoded sequentially instead.
+    public class ParallelDecompress {
+        public let threads: Int
+        
+        public init(threads: Int = ProcessInfo.processInfo.activeProcessorCount) {
+            self.threads = max(threads, 1)
+        }
+        
+        public func decompress(input: Data,
+                               output: inout Data) throws {
+            guard threads > 1,
+                  let index = try? Index(input),
+                  index.members.count > 1 else {
+                // Same finishing path as lunzipped(): truncation throws, trailing
+                // data is ignored
+                try Pool.shared.withDecompressor { decompressor in
+                    try input.withUnsafeBytes { (inBuffer: UnsafeRawBufferPointer) -> Void in
+                        try decompressor.decompress(input: inBuffer, options: .default) { chunk in
+                            output.append(chunk.bindMemory(to: UInt8.self))
+                        }
+                    }
+                }
+                return
+            }
+            
+            let start = output.count
+            do {
+                try input.withUnsafeBytes { (inBuffer: UnsafeRawBufferPointer) -> Void in
+                    // The trailers are not trusted for more than the input can plausibly
+                    // hold, so the output grows a window of members at a time and every
+                    // window is decoded and checked before the next is allocated
+                    let window = index.reservableDataSize
+                    var first = 0
+                    while first < index.members.count {
+                        var end = first + 1
+                        var size = index.members[first].dataSize
+                        while end < index.members.count && size + index.members[end].dataSize <= window {
+                            size += index.members[end].dataSize
+                            end += 1
+                        }
+                        
+                        if size > window {
+                            // A single member claiming more than that is decoded as it goes
+                            try decompress(input: inBuffer, member: index.members[first], appendingTo: &output)
+                        } else {
+                            let base = output.count
+                            output.count += size
+                            try output.withUnsafeMutableBytes { (outBuffer: UnsafeMutableRawBufferPointer) in
+                                try decompress(input: inBuffer,
+                                               members: index.members[first..<end],
+                                               into: UnsafeMutableRawBufferPointer(rebasing: outBuffer[base..<base + size]))
+                            }
+                        }
+                        first = end
+                    }
+                }
+            } catch {
+                output.count = start
+                throw error
+            }
+        }
+        
+        private func decompress(input: UnsafeRawBufferPointer,
+                                member: Member,
+                                appendingTo output: inout Data) throws {
+            let source = UnsafeRawBufferPointer(rebasing: input[member.offset..<member.offset + member.size])
+            let outcome = try Pool.shared.withDecompressor { decompressor in
+                try decompressor.decompress(input: source, options: .init(multimember: false)) { chunk in
+                    output.append(chunk.bindMemory(to: UInt8.self))
+                }
+            }
+            if outcome.outputSize != member.dataSize {
+                throw Lzip.Error(LZ_data_error)
+            }
+        }
+        
+        /// Decodes every member of `index` into its slice of `output`, which must hold
+        /// at least `index.dataSize` bytes.
+        func decompress(input: UnsafeRawBufferPointer,
+                        index: Index,
+                        into output: UnsafeMutableRawBufferPointer) throws {
+            try decompress(input: input, members: index.members[...], into: output)
+        }
+        
+        /// Decodes `members` in parallel into `output`, which starts at the data offset
+        /// of the first member and holds all of them.
+        private func decompress(input: UnsafeRawBufferPointer,
+                                members: ArraySlice<Member>,
+                                into output: UnsafeMutableRawBufferPointer) throws {
+            guard let base = members.first?.dataOffset else { return }
+            try Lzip.parallelForEach(count: members.count, threads: threads) { position in
+                let member = members[members.startIndex + position]
+                let source = UnsafeRawBufferPointer(rebasing: input[member.offset..<member.offset + member.size])
+                let offset = member.dataOffset - base
+                let destination = UnsafeMutableRawBufferPointer(rebasing: output[offset..<offset + member.dataSize])
+                
+                do {
+                    let count = try Pool.shared.withDecompressor { decompressor in
+                        try decompressor.decompress(input: source,
+                                                    into: destination)
+                    }
+                    if count != member.dataSize {
+                        throw Lzip.Error(LZ_data_error)
+                    }
+                } catch let error as Lzip.Error where error.kind == .overflow {
+                    // The member holds more data than its trailer claims
+                    throw Lzip.Error(LZ_data_error)
+                }
+            }
+        }
+    }
+}
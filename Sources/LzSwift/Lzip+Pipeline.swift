@@ -0,0 +1,230 @@
+import Foundation
+import lzlib
+
+extension Lzip {
+    /// Runs a compressor or decompressor as the middle stage of a three-stage pipeline,
+    /// so that reading the input, coding it and writing the output all overlap:
+    ///
+    /// - a reader thread fills input chunks from `read`
+    /// - the calling thread writes them to the stream, reading its output straight
+    ///   into output chunks
+    /// - a writer thread drains the output chunks to `write`
+    ///
+    /// The stages are joined by queues over a fixed set of `depth` reusable chunks on
+    /// each side, so a slow stage blocks its neighbours instead of buffering without
+    /// bound, and nothing is allocated once the pipeline is running. End-to-end time
+    /// approaches the slowest stage rather than the sum of all three.
+    public final class Pipeline {
+        public let chunkSize: Int
+        public let depth: Int
+        
+        public init(chunkSize: Int = 1 << 20,
+                    depth: Int = 4) {
+            self.chunkSize = max(chunkSize, 1)
+            self.depth = max(depth, 1)
+        }
+        
+        /// Pumps everything `read` produces through `stream` and into `write`. `read`
+        /// fills as much of the buffer as it likes and returns the count, 0 at the end
+        /// of the input; it is called on the reader thread, and `write` on the writer
+        /// thread. The first error from any stage stops the others and is rethrown.
+        public func run(_ stream: LzipStream,
+                        read: @escaping (UnsafeMutableRawBufferPointer) throws -> Int,
+                        write: @escaping (UnsafeRawBufferPointer) throws -> Void) throws {
+            let inputFree = ChunkQueue()
+            let inputFull = ChunkQueue()
+            let outputFree = ChunkQueue()
+            let outputFull = ChunkQueue()
+            for _ in 0..<depth {
+                inputFree.put(Chunk(capacity: chunkSize))
+                outputFree.put(Chunk(capacity: chunkSize))
+            }
+            
+            var failure: Swift.Error?
+            let lock = NSLock()
+            let fail = { (error: Swift.Error) in
+                lock.lock()
+                failure = failure ?? error
+                lock.unlock()
+                for queue in [inputFree, inputFull, outputFree, outputFull] {
+                    queue.cancel()
+                }
+            }
+            
+            let group = DispatchGroup()
+            DispatchQueue.global().async(group: group) {
+                do {
+                    while let chunk = inputFree.take() {
+                        chunk.count = try read(chunk.storage)
+                        if chunk.count == 0 {
+                            inputFull.close()
+                            return
+                        }
+                        inputFull.put(chunk)
+                    }
+                } catch {
+                    fail(error)
+                }
+            }
+            DispatchQueue.global().async(group: group) {
+                do {
+                    while let chunk = outputFull.take() {
+                        try write(UnsafeRawBufferPointer(rebasing: chunk.storage[0..<chunk.count]))
+                        chunk.count = 0
+                        outputFree.put(chunk)
+                    }
+                } catch {
+                    fail(error)
+                }
+            }
+            
+            do {
+                try code(stream,
+                         inputFree: inputFree,
+                         inputFull: inputFull,
+                         outputFree: outputFree,
+                         outputFull: outputFull)
+            } catch {
+                fail(error)
+            }
+            group.wait()
+            
+            if let failure = failure {
+                throw failure
+            }
+        }
+        
+        /// Streams `input` through `stream` into `output`, with the reads and writes on
+        /// their own threads.
+        public func run(_ stream: LzipStream,
+                        from input: FileHandle,
+                        to output: FileHandle) throws {
+            let inFd = input.fileDescriptor
+            let outFd = output.fileDescriptor
+            try run(stream, read: { buffer in
+                while true {
+                    let count = read(inFd, buffer.baseAddress, buffer.count)
+                    if count >= 0 {
+                        return count
+                    }
+                    if errno != EINTR {
+                        throw posixError()
+                    }
+                }
+            }, write: { bytes in
+                try writeAll(outFd, bytes)
+            })
+        }
+        
+        private func code(_ stream: LzipStream,
+                          inputFree: ChunkQueue,
+                          inputFull: ChunkQueue,
+                          outputFree: ChunkQueue,
+                          outputFull: ChunkQueue) throws {
+            guard var output = outputFree.take() else { return }
+            
+            func drain() throws {
+                while true {
+                    if output.count == output.storage.count {
+                        outputFull.put(output)
+                        guard let next = outputFree.take() else {
+                            throw Lzip.Error(kind: .cancelled)
+                        }
+                        output = next
+                    }
+                    let rd = try stream.read(into: UnsafeMutableRawBufferPointer(rebasing: output.storage[output.count...]))
+                    if rd == 0 {
+                        return
+                    }
+                    output.count += rd
+                }
+            }
+            
+            while let input = inputFull.take() {
+                var offset = 0
+                while offset < input.count {
+                    offset += try stream.write(UnsafeRawBufferPointer(rebasing: input.storage[offset..<input.count]))
+                    try drain()
+                }
+                input.count = 0
+                inputFree.put(input)
+            }
+            guard inputFull.isCancelled == false else { return }
+            
+            try stream.finish()
+            try drain()
+            if let decompressor = stream as? Decompress, decompressor.isFinished == false {
+                throw Lzip.Error(LZ_unexpected_eof)
+            }
+            if output.count > 0 {
+                outputFull.put(output)
+            }
+            outputFull.close()
+        }
+    }
+    
+    final class Chunk {
+        let storage: UnsafeMutableRawBufferPointer
+        var count = 0
+        
+        init(capacity: Int) {
+            storage = UnsafeMutableRawBufferPointer.allocate(byteCount: capacity,
+                                                             alignment: MemoryLayout<UInt64>.alignment)
+        }
+        
+        deinit {
+            storage.deallocate()
+        }
+    }
+    
+    /// Blocking FIFO handing chunks between pipeline stages
+    final class ChunkQueue {
+        private let condition = NSCondition()
+        private var chunks = [Chunk]()
+        private var isClosed = false
+        private var cancelled = false
+        
+        var isCancelled: Bool {
+            condition.lock()
+            defer { condition.unlock() }
+            return cancelled
+        }
+        
+        func put(_ chunk: Chunk) {
+            condition.lock()
+            if cancelled == false {
+                chunks.append(chunk)
+                condition.signal()
+            }
+            condition.unlock()
+        }
+        
+        /// The next chunk, waiting for one if needed, or nil once the queue is closed
+        /// and empty, or cancelled
+        func take() -> Chunk? {
+            condition.lock()
+            defer { condition.unlock() }
+            while chunks.isEmpty && isClosed == false && cancelled == false {
+                condition.wait()
+            }
+            return cancelled || chunks.isEmpty ? nil : chunks.removeFirst()
+        }
+        
+        /// No more chunks will be put; takers drain what is left
+        func close() {
+            condition.lock()
+            isClosed = true
+            condition.broadcast()
+            condition.unlock()
+        }
+        
+        /// Drops everything and wakes all takers
+        func cancel() {
+            condition.lock()
+            cancelled = true
+            chunks.removeAll()
+            condition.broadcast()
+            condition.unlock()
+        }
+    }
+}
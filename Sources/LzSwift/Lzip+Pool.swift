@@ -0,0 +1,200 @@
+import Foundation
+import lzlib
+
+extension Lzip {
+    /// Thread-safe pool of warmed contexts. Idle compressors are kept per set of
+    /// encoder parameters, so their dictionaries don't need to be allocated and faulted in again,
+    /// and idle decompressors are kept alongside them. `Parameters(level:inputSize:)`
+    /// only picks a few dictionary sizes per level, so compressors are reused across
+    /// inputs of mixed sizes.
+    ///
+    /// The free lists are split into shards picked by the calling thread, each with its
+    /// own lock, so concurrent callers rarely contend for the same one; a caller that
+    /// finds its shard empty looks through the others before making a new context. The
+    /// idle count and memory limits apply to the pool as a whole, through one running
+    /// tally that is only touched when a context goes in or comes out.
+    public final class Pool {
+        public static let shared = Pool()
+        
+        /// Maximum number of idle contexts kept for each level, whatever its dictionary
+        /// size, for each set of custom parameters, and for decompressors
+        public let maxIdle: Int
+        /// Maximum estimated heap footprint of all idle contexts, in bytes
+        public let memoryLimit: Int
+        
+        private final class Shard {
+            let lock = NSLock()
+            var compressors: [Parameters: [(context: Compress, footprint: Int)]] = [:]
+            var decompressors: [(context: Decompress, footprint: Int)] = []
+        }
+        
+        private let shards: [Shard]
+        
+        /// What `maxIdle` counts compressors by
+        private enum Group: Hashable {
+            case level(CompressionLevel)
+            case custom(Parameters)
+            
+            init(_ parameters: Parameters) {
+                self = parameters.level.map { .level($0) } ?? .custom(parameters)
+            }
+        }
+        
+        /// Pool-wide tally of idle contexts, never held together with a shard lock.
+        /// A slot is claimed here before the context is added to a shard, so the tally
+        /// may briefly count a context that is not listed yet, but never the reverse.
+        private let tallyLock = NSLock()
+        private var idleCompressors: [Group: Int] = [:]
+        private var idleDecompressors = 0
+        private var idleMemory = 0
+        
+        public init(maxIdle: Int = ProcessInfo.processInfo.activeProcessorCount,
+                    memoryLimit: Int = 512 * 1024 * 1024,
+                    shards: Int = ProcessInfo.processInfo.activeProcessorCount) {
+            self.maxIdle = max(maxIdle, 0)
+            self.memoryLimit = max(memoryLimit, 0)
+            self.shards = (0..<max(shards, 1)).map { _ in Shard() }
+        }
+        
+        /// Index of the calling thread's shard
+        private var shardIdx: Int {
+            #if canImport(Darwin)
+            let thread = UInt(bitPattern: pthread_self())
+            #else
+            let thread = UInt(pthread_self())
+            #endif
+            return Int(UInt(bitPattern: thread.hashValue) % UInt(shards.count))
+        }
+        
+        /// Pops an idle context with `take`, starting at the calling thread's shard
+        private func takeIdle<T>(_ take: (Shard) -> (context: T, footprint: Int)?) -> (context: T, footprint: Int)? {
+            let first = shardIdx
+            for offset in 0..<shards.count {
+                let shard = shards[(first + offset) % shards.count]
+                shard.lock.lock()
+                let idle = take(shard)
+                shard.lock.unlock()
+                if idle != nil {
+                    return idle
+                }
+            }
+            return nil
+        }
+        
+        /// Hands out an idle compressor for `level`, or a new one if none is idle.
+        public func compressor(level: CompressionLevel) -> Compress {
+            return compressor(parameters: Parameters(level: level))
+        }
+        
+        /// Hands out an idle compressor for `parameters`, or a new one if none is idle.
+        public func compressor(parameters: Parameters) -> Compress {
+            guard let idle = takeIdle({ $0.compressors[parameters]?.popLast() }) else {
+                return Compress(parameters: parameters)
+            }
+            tallyLock.lock()
+            idleCompressors[Group(idle.context.parameters), default: 0] -= 1
+            idleMemory -= idle.footprint
+            tallyLock.unlock()
+            return idle.context
+        }
+        
+        /// Hands out an idle decompressor, or a new one if none is idle.
+        public func decompressor() -> Decompress {
+            guard let idle = takeIdle({ $0.decompressors.popLast() }) else {
+                return Decompress()
+            }
+            tallyLock.lock()
+            idleDecompressors -= 1
+            idleMemory -= idle.footprint
+            tallyLock.unlock()
+            return idle.context
+        }
+        
+        /// Takes a compressor back. It is reset first; compressors that cannot be reset
+        /// or would exceed the pool limits are dropped.
+        public func recycle(_ compressor: Compress) {
+            compressor.progress = nil
+            guard (try? compressor.reset()) != nil else { return }
+            
+            let footprint = compressor.memoryFootprint
+            let parameters = compressor.parameters
+            let group = Group(parameters)
+            tallyLock.lock()
+            guard idleCompressors[group, default: 0] < maxIdle,
+                  idleMemory + footprint <= memoryLimit else {
+                tallyLock.unlock()
+                return
+            }
+            idleCompressors[group, default: 0] += 1
+            idleMemory += footprint
+            tallyLock.unlock()
+            
+            let shard = shards[shardIdx]
+            shard.lock.lock()
+            shard.compressors[parameters, default: []].append((context: compressor, footprint: footprint))
+            shard.lock.unlock()
+        }
+        
+        /// Takes a decompressor back. It is reset first; decompressors that cannot be
+        /// reset or would exceed the pool limits are dropped.
+        public func recycle(_ decompressor: Decompress) {
+            decompressor.progress = nil
+            guard (try? decompressor.reset()) != nil else { return }
+            
+            let footprint = decompressor.memoryFootprint
+            tallyLock.lock()
+            guard idleDecompressors < maxIdle,
+                  idleMemory + footprint <= memoryLimit else {
+                tallyLock.unlock()
+                return
+            }
+            idleDecompressors += 1
+            idleMemory += footprint
+            tallyLock.unlock()
+            
+            let shard = shards[shardIdx]
+            shard.lock.lock()
+            shard.decompressors.append((context: decompressor, footprint: footprint))
+            shard.lock.unlock()
+        }
+        
+        public func withCompressor<T>(level: CompressionLevel,
+                                      _ body: (Compress) throws -> T) rethrows -> T {
+            return try withCompressor(parameters: Parameters(level: level), body)
+        }
+        
+        public func withCompressor<T>(parameters: Parameters,
+                                      _ body: (Compress) throws -> T) rethrows -> T {
+            let compressor = self.compressor(parameters: parameters)
+            defer { recycle(compressor) }
+            return try body(compressor)
+        }
+        
+        public func withDecompressor<T>(_ body: (Decompress) throws -> T) rethrows -> T {
+            let decompressor = self.decompressor()
+            defer { recycle(decompressor) }
+            return try body(decompressor)
+        }
+        
+        /// Releases every idle context.
+        public func drain() {
+            for shard in shards {
+                shard.lock.lock()
+                let compressors = shard.compressors
+                let decompressors = shard.decompressors
+                shard.compressors.removeAll()
+                shard.decompressors.removeAll()
+                shard.lock.unlock()
+                
+                tallyLock.lock()
+                for idle in compressors.values.joined() {
+                    idleCompressors[Group(idle.context.parameters), default: 0] -= 1
+                    idleMemory -= idle.footprint
+                }
+                idleDecompressors -= decompressors.count
+                idleMemory -= decompressors.reduce(0) { $0 + $1.footprint }
+                tallyLock.unlock()
+            }
+        }
+    }
+}
@@ -0,0 +1,81 @@
+import Foundation
+import lzlib
+
+fileprivate let sampleBlocks = 8
+fileprivate let sampleBlockSize = 4096
+fileprivate let trialSize = 64 * 1024
+/// Order-0 entropy, in bits per byte, above which a trial compression is run
+fileprivate let entropyThreshold = 7.5
+/// Trial ratio above which the input is treated as incompressible
+fileprivate let ratioThreshold = 0.95
+
+extension Lzip {
+    /// Outcome of sampling an input before compressing it.
+    public struct Precheck {
+        /// Order-0 entropy of the sampled blocks, in bits per byte
+        public let entropy: Double
+        /// Estimated compressed size over input size: from a trial `.lvl0` compression
+        /// of a prefix when the entropy is high, otherwise the entropy bound
+        public let estimatedRatio: Double
+        public let isCompressible: Bool
+        /// Level chosen: the requested one, or `.lvl0` for incompressible input
+        public let level: CompressionLevel
+        
+        /// Samples `input` for compressing at `level`. A few blocks spread over the input
+        /// are histogrammed first, which is enough to recognise text and structured
+        /// data. Only near-random samples, typically media, archives or ciphertext, pay
+        /// for a trial `.lvl0` compression of a 64 KiB prefix, since repetitive data can
+        /// still have a flat byte histogram.
+        public init(_ input: UnsafeRawBufferPointer, level: CompressionLevel) {
+            var histogram = [Int](repeating: 0, count: 256)
+            var sampled = 0
+            let blocks = min(sampleBlocks, max(input.count / sampleBlockSize, 1))
+            for block in 0..<blocks {
+                let start = blocks > 1 ? block * (input.count - sampleBlockSize) / (blocks - 1) : 0
+                for byte in input[start..<min(start + sampleBlockSize, input.count)] {
+                    histogram[Int(byte)] += 1
+                }
+                sampled += min(sampleBlockSize, input.count - start)
+            }
+            
+            var entropy = 0.0
+            for count in histogram where count > 0 {
+                let p = Double(count) / Double(sampled)
+                entropy -= p * log2(p)
+            }
+            self.entropy = entropy
+            
+            guard entropy > entropyThreshold, input.count >= sampleBlockSize else {
+                estimatedRatio = entropy / 8
+                isCompressible = true
+                self.level = level
+                return
+            }
+            
+            let trial = UnsafeRawBufferPointer(rebasing: input.prefix(trialSize))
+            let scratch = UnsafeMutableRawBufferPointer.allocate(byteCount: Lzip.maxCompressedSize(for: trial.count),
+                                                                       alignment: MemoryLayout<UInt64>.alignment)
+            defer { scratch.deallocate() }
+            let compressed = (try? Pool.shared.withCompressor(level: .lvl0) { compressor -> Int in
+                try compressor.compress(input: trial, into: scratch)
+            }) ?? trial.count
+            
+            estimatedRatio = Double(compressed) / Double(trial.count)
+            isCompressible = estimatedRatio <= ratioThreshold
+            self.level = isCompressible ? level : .lvl0
+        }
+    }
+}
+
+extension Data {
+    /// Compresses like `lzipped(level:)`, but samples the input first and falls back
+    /// to a minimal-effort `.lvl0` member when it looks incompressible, e.g. media or
+    /// encrypted blobs, where higher levels burn CPU for no gain. The decision is
+    /// returned alongside the output.
+    public func lzipped(adaptiveLevel level: Lzip.CompressionLevel) throws -> (data: Data, precheck: Lzip.Precheck) {
+        let precheck = self.withUnsafeBytes { (bytes: UnsafeRawBufferPointer) in
+            Lzip.Precheck(bytes, level: level)
+        }
+        return (try lzipped(level: precheck.level) ?? Data(), precheck)
+    }
+}
@@ -0,0 +1,107 @@
+import Foundation
+import lzlib
+
+extension Lzip {
+    /// Compresses small, similar messages against a shared sample, so each one can
+    /// refer back to the sample's content instead of starting from an empty dictionary.
+    ///
+    /// lzip members always start from an empty dictionary and lzlib cannot snapshot an
+    /// encoder, so this is an LzSwift framing rather than a standard .lz stream. Every
+    /// message is compressed as one member holding the sample followed by the message.
+    /// The sample is sync flushed, and since the compressed bytes up to and including
+    /// that flush only depend on the sample and the parameters they are the same for
+    /// every message: this `prefix` is computed once and left out of the frames.
+    ///
+    /// - frame: the member's bytes after `prefix`, i.e. the message and the trailer
+    /// - decoding: `prefix + frame` is a complete member (with a sync flush marker, so
+    ///   for lzlib decoders), whose first `sample.count` bytes are the sample
+    ///
+    /// Both sides must use the same sample and parameters.
+    ///
+    /// This trades CPU for ratio. lzlib cannot save and restore a coder's state, so
+    /// every `compress(_:)` encodes the whole sample again before the message, and every
+    /// `decompress(_:)` decodes it again before the message; each call costs about as
+    /// much as coding `sample.count + message.count` bytes, even though the frame only
+    /// carries the message. Keep the sample to a few tens of KiB. For an ordered stream
+    /// of messages over one connection, `Compress.flush` keeps the dictionary without
+    /// that cost.
+    public final class PresetDictionary {
+        public let sample: Data
+        public let parameters: Parameters
+        /// Compressed header and sample, shared by every frame
+        public let prefix: Data
+        
+        /// Uses `level`'s settings, with a dictionary large enough for the sample and
+        /// a 64 KiB message.
+        public convenience init(sample: Data,
+                                level: CompressionLevel) throws {
+            try self.init(sample: sample,
+                          parameters: Parameters(level: level, inputSize: sample.count + 64 * 1024))
+        }
+        
+        public init(sample: Data,
+                    parameters: Parameters) throws {
+            self.sample = sample
+            self.parameters = parameters
+            self.prefix = try Pool.shared.withCompressor(parameters: parameters) { compressor -> Data in
+                var prefix = Data()
+                try compressor.compress(input: sample, output: &prefix)
+                try compressor.flush(output: &prefix)
+                return prefix
+            }
+        }
+        
+        /// Compresses `message` into a frame for this dictionary.
+        public func compress(_ message: Data) throws -> Data {
+            return try Pool.shared.withCompressor(parameters: parameters) { compressor -> Data in
+                var output = Data(capacity: prefix.count + Lzip.maxCompressedSize(for: message.count))
+                try compressor.compress(input: sample, output: &output)
+                try compressor.flush(output: &output)
+                guard output == prefix else {
+                    // Would mean the encoder is not deterministic
+                    throw Lzip.Error(kind: .library)
+                }
+                
+                output.removeAll(keepingCapacity: true)
+                try compressor.compress(input: message, output: &output)
+                try compressor.finish { chunk in
+                    output.append(chunk.bindMemory(to: UInt8.self))
+                }
+                return output
+            }
+        }
+        
+        /// Decompresses a frame produced by `compress(_:)` with the same sample and
+        /// parameters. The member's CRC and size, which cover the sample too, are
+        /// checked as usual.
+        public func decompress(_ frame: Data) throws -> Data {
+            // The trailer records the size of the sample plus the message
+            var trailerDataSize: UInt64 = 0
+            if frame.count >= 20 {
+                trailerDataSize = frame.suffix(16).prefix(8).reversed().reduce(0) { $0 << 8 | UInt64($1) }
+            }
+            let messageSize = Int(clamping: trailerDataSize) - sample.count
+            let capacity = Index.reservable(dataSize: messageSize, compressedSize: prefix.count + frame.count)
+            
+            return try Pool.shared.withDecompressor { decompressor -> Data in
+                var output = Data(capacity: capacity)
+                var skipped = 0
+                let sink = { (chunk: UnsafeRawBufferPointer) -> Void in
+                    let skip = min(chunk.count, self.sample.count - skipped)
+                    skipped += skip
+                    if skip < chunk.count {
+                        output.append(UnsafeRawBufferPointer(rebasing: chunk[skip...]).bindMemory(to: UInt8.self))
+                    }
+                }
+                
+                for part in [prefix, frame] {
+                    try part.withUnsafeBytes { (input: UnsafeRawBufferPointer) -> Void in
+                        try decompressor.decompress(input: input, sink: sink)
+                    }
+                }
+                try decompressor.finish(sink: sink)
+                return output
+            }
+        }
+    }
+}
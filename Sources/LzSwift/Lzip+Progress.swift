@@ -0,0 +1,124 @@
+import Foundation
+import lzlib
+
+extension Lzip {
+    /// Snapshot of a context's work since its progress handler was installed or the
+    /// context was last reset.
+    public struct Progress {
+        /// Bytes written to the context
+        public let totalIn: Int
+        /// Bytes produced by the context, read or not
+        public let totalOut: Int
+        /// Input bytes of the current member processed so far, like `totalIn`: for
+        /// `Compress` the uncompressed bytes going into the member being written, for
+        /// `Decompress` the compressed bytes of the member being decoded
+        public let memberPosition: Int
+        public let elapsed: TimeInterval
+        
+        /// `totalOut / totalIn`. When compressing, below 1 is a gain and close to 1
+        /// means the input hardly compresses; when decompressing, the expansion factor.
+        public var ratio: Double {
+            return totalIn > 0 ? Double(totalOut) / Double(totalIn) : 0
+        }
+        
+        /// Input throughput, in MB (10^6 bytes) per second
+        public var mbPerSecond: Double {
+            return elapsed > 0 ? Double(totalIn) / elapsed / 1e6 : 0
+        }
+    }
+    
+    final class ProgressTracker {
+        private let interval: Int
+        private let handler: (Progress) -> Bool
+        private var start = DispatchTime.now().uptimeNanoseconds
+        private var baseIn: UInt64
+        private var baseOut: UInt64
+        private var pending = 0
+        
+        init(interval: Int,
+             handler: @escaping (Progress) -> Bool,
+             totalIn: UInt64,
+             totalOut: UInt64) {
+            self.interval = max(interval, 1)
+            self.handler = handler
+            baseIn = totalIn
+            baseOut = totalOut
+        }
+        
+        /// Counts from the context's current totals again
+        func restart(totalIn: UInt64, totalOut: UInt64) {
+            start = DispatchTime.now().uptimeNanoseconds
+            baseIn = totalIn
+            baseOut = totalOut
+            pending = 0
+        }
+        
+        @inline(__always)
+        func didWrite(_ count: Int) {
+            pending += count
+        }
+        
+        @inline(__always)
+        var isDue: Bool {
+            return pending >= interval
+        }
+        
+        /// Calls the handler, throwing `.cancelled` if it asks to stop
+        func report(totalIn: UInt64, totalOut: UInt64, memberPosition: UInt64) throws {
+            pending = 0
+            let progress = Progress(totalIn: Int(totalIn - baseIn),
+                                    totalOut: Int(totalOut - baseOut),
+                                    memberPosition: Int(memberPosition),
+                                    elapsed: TimeInterval(DispatchTime.now().uptimeNanoseconds - start) / 1e9)
+            if handler(progress) == false {
+                throw Lzip.Error(kind: .cancelled)
+            }
+        }
+    }
+}
+
+extension Lzip.Compress {
+    /// Calls `handler` roughly every `interval` bytes of input, and once more when a
+    /// member is finished. Returning false cancels the job: the call in progress
+    /// throws `.cancelled`, and the context must be reset before it is used again.
+    /// Pass nil to remove the handler; handlers are also removed when the context is
+    /// recycled into a pool.
+    public func setProgressHandler(interval: Int = 1 << 20,
+                                   _ handler: ((Lzip.Progress) -> Bool)?) {
+        progress = handler.map {
+            Lzip.ProgressTracker(interval: interval,
+                                 handler: $0,
+                                 totalIn: LZ_compress_total_in_size(encoder),
+                                 totalOut: LZ_compress_total_out_size(encoder))
+        }
+    }
+    
+    func reportProgress() throws {
+        try progress?.report(totalIn: LZ_compress_total_in_size(encoder),
+                             totalOut: LZ_compress_total_out_size(encoder),
+                             memberPosition: LZ_compress_member_position(encoder))
+    }
+}
+
+extension Lzip.Decompress {
+    /// Calls `handler` roughly every `interval` bytes of compressed input, and once
+    /// more when the stream is finished. Returning false cancels the job: the call in
+    /// progress throws `.cancelled`, and the context must be reset before it is used
+    /// again. Pass nil to remove the handler; handlers are also removed when the
+    /// context is recycled into a pool.
+    public func setProgressHandler(interval: Int = 1 << 20,
+                                   _ handler: ((Lzip.Progress) -> Bool)?) {
+        progress = handler.map {
+            Lzip.ProgressTracker(interval: interval,
+                                 handler: $0,
+                                 totalIn: LZ_decompress_total_in_size(decoder),
+                                 totalOut: LZ_decompress_total_out_size(decoder))
+        }
+    }
+    
+    func reportProgress() throws {
+        try progress?.report(totalIn: LZ_decompress_total_in_size(decoder),
+                             totalOut: LZ_decompress_total_out_size(decoder),
+                             memberPosition: LZ_decompress_member_position(decoder))
+    }
+}
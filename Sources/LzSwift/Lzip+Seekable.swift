@@ -0,0 +1,144 @@
+import Foundation
+import lzlib
+
+fileprivate let scratchSize = 64 * 1024
+
+extension Lzip {
+    /// Random access into a multimember .lz stream. The member index is built from the
+    /// trailers when the reader is opened, and a read decodes only the members that
+    /// cover the requested range, stopping as soon as the range is complete.
+    public final class SeekableReader {
+        public let index: Index
+        
+        /// What `<name>.idx` holds: the index, and the file it was built from
+        struct CachedIndex: Codable {
+            let fileSize: Int
+            let modified: TimeInterval
+            let index: Index
+        }
+        
+        private let mapped: MappedFile?
+        private let data: Data?
+        
+        public init(data: Data) throws {
+            self.data = data
+            self.mapped = nil
+            self.index = try Index(data)
+        }
+        
+        /// Maps the file at `url`. With `cacheIndex` the index is stored next to the file
+        /// as `<name>.idx` and reused by later readers, which then read only the last
+        /// member's header and trailer instead of every member's. The cache is used as
+        /// long as the file's size and modification time are unchanged and its last
+        /// member still matches; otherwise it is rebuilt.
+        public init(contentsOf url: URL,
+                    cacheIndex: Bool = false) throws {
+            let mapped = try MappedFile(url: url)
+            self.mapped = mapped
+            self.data = nil
+            
+            let indexURL = url.appendingPathExtension("idx")
+            let modified = cacheIndex ? SeekableReader.modificationTime(of: url) : nil
+            if let modified = modified,
+               let cached = try? JSONDecoder().decode(CachedIndex.self, from: Data(contentsOf: indexURL)),
+               cached.modified == modified,
+               mapped.withBytes({ cached.fileSize == $0.count && cached.index.describes($0) }) {
+                self.index = cached.index
+                return
+            }
+            
+            self.index = try mapped.withBytes { try Index($0) }
+            if let modified = modified {
+                let cached = CachedIndex(fileSize: index.compressedSize, modified: modified, index: index)
+                try? JSONEncoder().encode(cached).write(to: indexURL, options: .atomic)
+            }
+        }
+        
+        private static func modificationTime(of url: URL) -> TimeInterval? {
+            let attributes = try? FileManager.default.attributesOfItem(atPath: url.path)
+            return (attributes?[.modificationDate] as? Date)?.timeIntervalSince1970
+        }
+        
+        /// Size of the decompressed stream
+        public var count: Int {
+            return index.dataSize
+        }
+        
+        /// Decompresses `length` bytes starting at decompressed `offset`. The range is
+        /// clipped to the end of the stream.
+        public func read(offset: Int, length: Int) throws -> Data {
+            let (sum, overflow) = offset.addingReportingOverflow(max(length, 0))
+            let end = min(overflow ? Int.max : sum, index.dataSize)
+            guard offset >= 0, offset < end, var memberIdx = index.member(containing: offset) else {
+                return Data()
+            }
+            
+            var output = Data(capacity: min(end - offset, index.reservableDataSize))
+            let scratch = UnsafeMutableRawBufferPointer.allocate(byteCount: scratchSize,
+                                                                 alignment: MemoryLayout<UInt64>.alignment)
+            defer { scratch.deallocate() }
+            
+            try withBytes { bytes in
+                while memberIdx < index.members.count && index.members[memberIdx].dataOffset < end {
+                    try read(member: index.members[memberIdx],
+                             from: bytes,
+                             range: offset..<end,
+                             scratch: scratch,
+                             into: &output)
+                    memberIdx += 1
+                }
+            }
+            return output
+        }
+        
+        private func read(member: Member,
+                          from bytes: UnsafeRawBufferPointer,
+                          range: Range<Int>,
+                          scratch: UnsafeMutableRawBufferPointer,
+                          into output: inout Data) throws {
+            let source = UnsafeRawBufferPointer(rebasing: bytes[member.offset..<member.offset + member.size])
+            let end = min(range.upperBound, member.dataOffset + member.dataSize)
+            
+            try Pool.shared.withDecompressor { decompressor in
+                var inOffset = 0
+                var inputFinished = false
+                var position = member.dataOffset
+                
+                while position < end {
+                    if inOffset < source.count {
+                        inOffset += try decompressor.write(UnsafeRawBufferPointer(rebasing: source[inOffset...]))
+                    } else if inputFinished == false {
+                        try decompressor.finish()
+                        inputFinished = true
+                    }
+                    
+                    let rd = try decompressor.read(into: scratch)
+                    if rd == 0 {
+                        if inputFinished {
+                            throw Lzip.Error(LZ_unexpected_eof)
+                        }
+                        continue
+                    }
+                    
+                    // Keep only the part of this chunk that falls inside the range
+                    let low = max(position, range.lowerBound)
+                    let high = min(position + rd, end)
+                    if low < high {
+                        output.append(UnsafeRawBufferPointer(rebasing: scratch[(low - position)..<(high - position)]).bindMemory(to: UInt8.self))
+                    }
+                    position += rd
+                }
+            }
+        }
+        
+        private func withBytes<T>(_ body: (UnsafeRawBufferPointer) throws -> T) rethrows -> T {
+            if let mapped = mapped {
+                return try mapped.withBytes(body)
+            }
+            return try data!.withUnsafeBytes { (bytes: UnsafeRawBufferPointer) in
+                try body(bytes)
+            }
+        }
+        
+    }
+}
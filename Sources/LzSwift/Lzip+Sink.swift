@@ -0,0 +1,95 @@
+import Foundation
+import lzlib
+
+/// Growable destination for compressed or decompressed output, so results can be
+/// appended to whatever storage the caller already uses instead of a fresh `Data`.
+public protocol LzipSink {
+    /// Appends `bytes`, which are only valid for the duration of the call
+    mutating func write(_ bytes: UnsafeRawBufferPointer)
+    /// Called once before writing with the expected number of further bytes, when
+    /// it is known
+    mutating func reserve(_ additional: Int)
+}
+
+extension LzipSink {
+    public mutating func reserve(_ additional: Int) {
+    }
+}
+
+extension Data: LzipSink {
+    public mutating func write(_ bytes: UnsafeRawBufferPointer) {
+        append(bytes.bindMemory(to: UInt8.self))
+    }
+    
+    public mutating func reserve(_ additional: Int) {
+        reserveCapacity(count + additional)
+    }
+}
+
+extension Array: LzipSink where Element == UInt8 {
+    public mutating func write(_ bytes: UnsafeRawBufferPointer) {
+        append(contentsOf: bytes)
+    }
+    
+    public mutating func reserve(_ additional: Int) {
+        reserveCapacity(count + additional)
+    }
+}
+
+extension Lzip {
+    /// Compresses `input` as one member appended to `output`. The input is read in
+    /// place, whatever owns it.
+    public static func compress<Output: LzipSink>(_ input: UnsafeRawBufferPointer,
+                                                  level: CompressionLevel,
+                                                  into output: inout Output) throws {
+        output.reserve(maxCompressedSize(for: input.count))
+        try Pool.shared.withCompressor(parameters: Parameters(level: level, inputSize: input.count)) { compressor in
+            try compressor.compress(input: input) { output.write($0) }
+            try compressor.finish { output.write($0) }
+        }
+    }
+    
+    /// Decompresses the stream in `input`, appending the data to `output`. Trailing
+    /// data is ignored and truncation throws, as with `Data.lunzipped()`.
+    public static func decompress<Output: LzipSink>(_ input: UnsafeRawBufferPointer,
+                                                    into output: inout Output) throws {
+        if let index = try? Index(input) {
+            output.reserve(index.reservableDataSize)
+        }
+        try Pool.shared.withDecompressor { decompressor in
+            try decompressor.decompress(input: input, options: .default) { output.write($0) }
+        }
+    }
+}
+
+extension ContiguousBytes {
+    /// Compresses these bytes in place, without bridging them to `Data` first,
+    /// appending the member to `output`.
+    public func lzipped<Output: LzipSink>(level: Lzip.CompressionLevel,
+                                          into output: inout Output) throws {
+        try withUnsafeBytes { (input: UnsafeRawBufferPointer) in
+            try Lzip.compress(input, level: level, into: &output)
+        }
+    }
+    
+    /// Decompresses these bytes in place, appending the data to `output`.
+    public func lunzipped<Output: LzipSink>(into output: inout Output) throws {
+        try withUnsafeBytes { (input: UnsafeRawBufferPointer) in
+            try Lzip.decompress(input, into: &output)
+        }
+    }
+}
+
+extension Array where Element == UInt8 {
+    public func lzipped(level: Lzip.CompressionLevel) throws -> [UInt8] {
+        var output = [UInt8]()
+        try lzipped(level: level, into: &output)
+        return output
+    }
+    
+    public func lunzipped() throws -> [UInt8] {
+        var output = [UInt8]()
+        try lunzipped(into: &output)
+        return output
+    }
+}
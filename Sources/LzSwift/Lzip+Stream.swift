@@ -0,0 +1,95 @@
+import Foundation
+import lzlib
+
+/// Push/pull interface shared by Lzip.Compress and Lzip.Decompress, for callers that
+/// own both the input and output buffers, such as a SwiftNIO channel handler working
+/// on ByteBuffers. Nothing is copied through LzSwift's own buffers:
+///
+/// - `write` hands bytes straight to LZ_*_write and returns how many were taken, which
+///   may be fewer than offered when the context's input buffer is full
+/// - `read` has LZ_*_read fill the caller's buffer and returns the count, 0 meaning no
+///   output is available until more is written
+/// - `finish` marks the end of the input; keep reading until `read` returns 0
+public protocol LzipStream: AnyObject {
+    func write(_ input: UnsafeRawBufferPointer) throws -> Int
+    func read(into output: UnsafeMutableRawBufferPointer) throws -> Int
+    func finish() throws
+}
+
+extension Lzip.Compress: LzipStream {
+    public func write(_ input: UnsafeRawBufferPointer) throws -> Int {
+        guard let inBuffer = input.baseAddress?.assumingMemoryBound(to: UInt8.self) else { return 0 }
+        isPristine = false
+        let inMaxSize = min(input.count, Int(LZ_compress_write_size(encoder)))
+        guard inMaxSize > 0 else { return 0 }
+        let wr = LZ_compress_write(encoder, inBuffer, Int32(truncatingIfNeeded: inMaxSize))
+        if wr < 0 {
+            throw Lzip.Error(LZ_compress_errno(encoder))
+        }
+        if let progress = progress {
+            progress.didWrite(Int(wr))
+            if progress.isDue {
+                try reportProgress()
+            }
+        }
+        return Int(wr)
+    }
+    
+    public func read(into output: UnsafeMutableRawBufferPointer) throws -> Int {
+        guard let outBuffer = output.baseAddress?.assumingMemoryBound(to: UInt8.self) else { return 0 }
+        let rd = LZ_compress_read(encoder, outBuffer, Int32(clamping: output.count))
+        if rd < 0 {
+            throw Lzip.Error(LZ_compress_errno(encoder))
+        }
+        return Int(rd)
+    }
+    
+    public func finish() throws {
+        isPristine = false
+        if LZ_compress_finish(encoder) < 0 {
+            throw Lzip.Error(LZ_compress_errno(encoder))
+        }
+    }
+    
+    /// Sync flush for stream callers; keep reading until `read` returns 0.
+    public func flush() throws {
+        isPristine = false
+        if LZ_compress_sync_flush(encoder) < 0 {
+            throw Lzip.Error(LZ_compress_errno(encoder))
+        }
+    }
+}
+
+extension Lzip.Decompress: LzipStream {
+    public func write(_ input: UnsafeRawBufferPointer) throws -> Int {
+        guard let inBuffer = input.baseAddress?.assumingMemoryBound(to: UInt8.self) else { return 0 }
+        let inMaxSize = min(input.count, Int(LZ_decompress_write_size(decoder)))
+        guard inMaxSize > 0 else { return 0 }
+        let wr = LZ_decompress_write(decoder, inBuffer, Int32(truncatingIfNeeded: inMaxSize))
+        if wr < 0 {
+            throw Lzip.Error(LZ_decompress_errno(decoder))
+        }
+        if let progress = progress {
+            progress.didWrite(Int(wr))
+            if progress.isDue {
+                try reportProgress()
+            }
+        }
+        return Int(wr)
+    }
+    
+    public func read(into output: UnsafeMutableRawBufferPointer) throws -> Int {
+        guard let outBuffer = output.baseAddress?.assumingMemoryBound(to: UInt8.self) else { return 0 }
+        let rd = LZ_decompress_read(decoder, outBuffer, Int32(clamping: output.count))
+        if rd < 0 {
+            throw Lzip.Error(LZ_decompress_errno(decoder))
+        }
+        return Int(rd)
+    }
+    
+    public func finish() throws {
+        if LZ_decompress_finish(decoder) < 0 {
+            throw Lzip.Error(LZ_decompress_errno(decoder))
+        }
+    }
+}
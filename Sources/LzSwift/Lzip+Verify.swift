@@ -0,0 +1,113 @@
+import Foundation
+import lzlib
+
+fileprivate let scratchSize = 64 * 1024
+
+extension Lzip {
+    /// Integrity report for a stream, one entry per member.
+    public struct Verification {
+        public struct MemberResult {
+            public let member: Member
+            /// Bytes the member actually decoded to
+            public let dataSize: Int
+            /// CRC32 of the decoded data, from LZ_decompress_data_crc, or 0 if the member
+            /// did not decode to the end
+            public let crc: UInt32
+            /// Why decoding failed, if it did
+            public let error: Lzip.Error?
+            
+            public var isValid: Bool {
+                return error == nil && dataSize == member.dataSize && crc == member.crc
+            }
+        }
+        
+        public let members: [MemberResult]
+        
+        public var isValid: Bool {
+            return members.allSatisfy { $0.isValid }
+        }
+    }
+    
+    /// Decodes every member of `input` without keeping any output, checking its CRC and
+    /// size against its trailer. Members are verified in parallel, each one decoding
+    /// into a 64 KiB scratch buffer, so memory use does not grow with the stream. Corrupt members are reported, not thrown; only an input that cannot be
+    /// indexed throws.
+    public static func verify(_ input: UnsafeRawBufferPointer,
+                              threads: Int = ProcessInfo.processInfo.activeProcessorCount) throws -> Verification {
+        let index = try Index(input)
+        var results = [Verification.MemberResult?](repeating: nil, count: index.members.count)
+        
+        try results.withUnsafeMutableBufferPointer { results in
+            try parallelForEach(count: index.members.count, threads: threads) { memberIdx in
+                let scratch = UnsafeMutableRawBufferPointer.allocate(byteCount: scratchSize,
+                                                                     alignment: MemoryLayout<UInt64>.alignment)
+                defer { scratch.deallocate() }
+                
+                let member = index.members[memberIdx]
+                let source = UnsafeRawBufferPointer(rebasing: input[member.offset..<member.offset + member.size])
+                results[memberIdx] = Pool.shared.withDecompressor { decompressor in
+                    decompressor.verify(member: member, source: source, scratch: scratch)
+                }
+            }
+        }
+        
+        return Verification(members: results.map { $0! })
+    }
+    
+    public static func verify(_ input: Data,
+                              threads: Int = ProcessInfo.processInfo.activeProcessorCount) throws -> Verification {
+        return try input.withUnsafeBytes { (bytes: UnsafeRawBufferPointer) in
+            try verify(bytes, threads: threads)
+        }
+    }
+    
+    /// Verifies the file at `url` through a memory mapping, so it never has to be read
+    /// into memory.
+    public static func verifyFile(at url: URL,
+                                  threads: Int = ProcessInfo.processInfo.activeProcessorCount) throws -> Verification {
+        return try MappedFile(url: url).withBytes { (bytes: UnsafeRawBufferPointer) in
+            try verify(bytes, threads: threads)
+        }
+    }
+}
+
+extension Lzip.Decompress {
+    func verify(member: Lzip.Member,
+                source: UnsafeRawBufferPointer,
+                scratch: UnsafeMutableRawBufferPointer) -> Lzip.Verification.MemberResult {
+        var dataSize = 0
+        var crc: UInt32 = 0
+        do {
+            var inOffset = 0
+            var inputFinished = false
+            while true {
+                if inOffset < source.count {
+                    inOffset += try write(UnsafeRawBufferPointer(rebasing: source[inOffset...]))
+                } else if inputFinished == false {
+                    try finish()
+                    inputFinished = true
+                }
+                
+                let rd = try read(into: scratch)
+                dataSize += rd
+                // The CRC has to be taken now: the next read frees the member's decoder
+                if LZ_decompress_member_finished(decoder) == 1 {
+                    crc = LZ_decompress_data_crc(decoder)
+                    break
+                }
+                if rd == 0 && inputFinished {
+                    throw Lzip.Error(LZ_unexpected_eof)
+                }
+            }
+        } catch {
+            return Lzip.Verification.MemberResult(member: member,
+                                                  dataSize: dataSize,
+                                                  crc: crc,
+                                                  error: error as? Lzip.Error ?? Lzip.Error(kind: .unknown))
+        }
+        return Lzip.Verification.MemberResult(member: member,
+                                              dataSize: dataSize,
+                                              crc: crc,
+                                              error: nil)
+    }
+}
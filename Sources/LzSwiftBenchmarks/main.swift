@@ -0,0 +1,483 @@
+import Foundation
+import LzSwift
+import LzSwiftHeapCounters
+
+// Throughput and memory benchmarks for LzSwift.
+//
+//     LzSwiftBenchmarks [--levels 0,6,9] [--sizes 1K,1M,1G] [--corpora text,json,binary,random]
+//                       [--min-time 1.0]
+//     LzSwiftBenchmarks --steady-state [--levels 0,6,9]
+//     LzSwiftBenchmarks --compare base.jsonl other.jsonl
+//
+// Every combination of corpus, size, level and operation runs in its own child
+// process, so the peak RSS reported for a case belongs to that case alone. Results
+// are written to stdout as one JSON object per line.
+//
+// --steady-state instead streams 64 KiB chunks through a warm compressor and
+// decompressor in this process and reports the allocation calls and heap growth per
+// chunk, which should all be zero: the chunk loops only ever write into buffers that
+// already exist.
+//
+// Every result records the lzlib it ran against and how both were built, so runs on
+// different platforms or lzlib builds can be told apart; --compare pairs up the cases
+// two result files have in common and reports the speedup of the second.
+
+struct Environment: Codable {
+    /// LZ_version() of the lzlib actually linked
+    let lzlibVersion: String
+    /// How that lzlib was built, from LZLIB_BUILD; set by `make bench-tuned`
+    let lzlibBuild: String
+    /// SWIFT_BUILD_FLAGS the benchmark was built with, as passed on by the Makefile
+    let swiftBuildFlags: String
+    /// Optimization settings this binary was actually compiled with
+    let configuration: String
+    let platform: String
+    let osVersion: String
+    
+    static let current: Environment = {
+        let environment = ProcessInfo.processInfo.environment
+        
+        var configuration = "release"
+        if _isDebugAssertConfiguration() {
+            configuration = "debug"
+        } else if _isFastAssertConfiguration() {
+            configuration = "unchecked"
+        }
+        
+        #if os(Linux)
+        let os = "Linux"
+        #elseif os(macOS)
+        let os = "macOS"
+        #else
+        let os = "other"
+        #endif
+        #if arch(x86_64)
+        let arch = "x86_64"
+        #elseif arch(arm64)
+        let arch = "arm64"
+        #else
+        let arch = "other"
+        #endif
+        
+        return Environment(lzlibVersion: Lzip.libraryVersion,
+                           lzlibBuild: environment["LZLIB_BUILD"] ?? "system",
+                           swiftBuildFlags: environment["SWIFT_BUILD_FLAGS"] ?? "",
+                           configuration: configuration,
+                           platform: "\(os) \(arch)",
+                           osVersion: ProcessInfo.processInfo.operatingSystemVersionString)
+    }()
+}
+
+struct Result: Codable {
+    let operation: String
+    let corpus: String
+    let level: Int
+    let size: Int
+    let compressedSize: Int
+    let iterations: Int
+    /// Fastest single iteration
+    let seconds: Double
+    /// Uncompressed bytes per second of the fastest iteration, in MB (10^6 bytes)
+    let mbPerSecond: Double
+    /// Peak resident set size of the process, in bytes
+    let peakRSS: Int
+    /// Peak resident set size before the timed operation started, i.e. the corpus itself
+    let baselineRSS: Int
+    /// Missing from results recorded before it was introduced
+    let environment: Environment?
+    
+    var key: String {
+        return "\(operation) \(corpus) \(level) \(size)"
+    }
+}
+
+enum BenchmarkError: Error {
+    case roundTrip
+}
+
+enum Corpus: String, CaseIterable {
+    case text
+    case json
+    case binary
+    case random
+}
+
+/// SplitMix64, so every run benchmarks exactly the same bytes
+struct Generator {
+    var state: UInt64
+    
+    mutating func next() -> UInt64 {
+        state &+= 0x9e3779b97f4a7c15
+        var z = state
+        z = (z ^ (z >> 30)) &* 0xbf58476d1ce4e5b9
+        z = (z ^ (z >> 27)) &* 0x94d049bb133111eb
+        return z ^ (z >> 31)
+    }
+    
+    mutating func next(_ bound: Int) -> Int {
+        return Int(next() % UInt64(bound))
+    }
+}
+
+let words = ("lorem ipsum dolor sit amet consectetur adipiscing elit sed do eiusmod tempor incididunt ut " +
+    "labore et dolore magna aliqua enim ad minim veniam quis nostrud exercitation ullamco laboris nisi " +
+    "aliquip ex ea commodo consequat duis aute irure in reprehenderit voluptate velit esse cillum " +
+    "fugiat nulla pariatur excepteur sint occaecat cupidatat non proident sunt culpa qui officia " +
+    "deserunt mollit anim id est laborum").split(separator: " ").map { Array($0.utf8) }
+
+func generate(_ corpus: Corpus, size: Int) -> Data {
+    var generator = Generator(state: 0x4c5a4950)
+    var data = Data(capacity: size + 4096)
+    
+    switch corpus {
+    case .text:
+        while data.count < size {
+            let sentence = 4 + generator.next(12)
+            for i in 0..<sentence {
+                var word = words[generator.next(words.count)]
+                if i == 0 {
+                    word[0] -= 0x20
+                }
+                data.append(contentsOf: word)
+                data.append(i == sentence - 1 ? 0x2e : 0x20)
+            }
+            data.append(generator.next(6) == 0 ? 0x0a : 0x20)
+        }
+    case .json:
+        data.append(contentsOf: Array("[\n".utf8))
+        var id = 0
+        while data.count < size {
+            let name = "\(String(decoding: words[generator.next(words.count)], as: UTF8.self)) \(String(decoding: words[generator.next(words.count)], as: UTF8.self))"
+            let record = "  {\"id\": \(id), \"name\": \"\(name)\", \"active\": \(generator.next(2) == 0), " +
+                "\"score\": \(Double(generator.next(100000)) / 100), \"tags\": [\"\(String(decoding: words[generator.next(words.count)], as: UTF8.self))\"]},\n"
+            data.append(contentsOf: Array(record.utf8))
+            id += 1
+        }
+    case .binary:
+        // Fixed-layout telemetry records: timestamp, sensor id, slowly drifting reading
+        var timestamp = UInt64(1_600_000_000_000)
+        var reading = Int32(0)
+        while data.count < size {
+            timestamp += UInt64(100 + generator.next(10))
+            reading += Int32(generator.next(65)) - 32
+            var record = (timestamp.littleEndian, UInt32(generator.next(16)).littleEndian, reading.littleEndian)
+            withUnsafeBytes(of: &record) { data.append(contentsOf: $0) }
+        }
+    case .random:
+        while data.count < size {
+            var value = generator.next()
+            withUnsafeBytes(of: &value) { data.append(contentsOf: $0) }
+        }
+    }
+    
+    data.count = size
+    return data
+}
+
+/// Peak resident set size of this process, in bytes
+func peakRSS() -> Int {
+    #if os(Linux)
+    guard let status = try? String(contentsOfFile: "/proc/self/status", encoding: .utf8),
+          let line = status.split(separator: "\n").first(where: { $0.hasPrefix("VmHWM:") }),
+          let kilobytes = Int(line.split(whereSeparator: { $0 == " " || $0 == "\t" })[1]) else {
+        return 0
+    }
+    return kilobytes * 1024
+    #else
+    var usage = rusage()
+    guard getrusage(RUSAGE_SELF, &usage) == 0 else { return 0 }
+    return Int(usage.ru_maxrss)
+    #endif
+}
+
+func now() -> Double {
+    return Double(DispatchTime.now().uptimeNanoseconds) / 1e9
+}
+
+/// Runs `body` until at least `minTime` seconds have passed, returning the iteration
+/// count and the fastest iteration
+func measure(minTime: Double, _ body: () throws -> Void) rethrows -> (iterations: Int, seconds: Double) {
+    var iterations = 0
+    var best = Double.infinity
+    let start = now()
+    repeat {
+        let before = now()
+        try body()
+        best = min(best, now() - before)
+        iterations += 1
+    } while now() - start < minTime
+    return (iterations, best)
+}
+
+func runCase(operation: String,
+             corpus: Corpus,
+             levelIndex: Int,
+             size: Int,
+             minTime: Double) throws -> Result {
+    let level = Lzip.CompressionLevel.allCases[levelIndex]
+    var compressedSize = 0
+    let timing: (iterations: Int, seconds: Double)
+    let baseline: Int
+    
+    if operation == "compress" {
+        let input = generate(corpus, size: size)
+        baseline = peakRSS()
+        timing = try measure(minTime: minTime) {
+            compressedSize = try input.lzipped(level: level)?.count ?? 0
+        }
+    } else {
+        // Only the compressed form is kept alive while decompressing
+        guard let compressed = try generate(corpus, size: size).lzipped(level: level) else {
+            throw BenchmarkError.roundTrip
+        }
+        compressedSize = compressed.count
+        baseline = peakRSS()
+        timing = try measure(minTime: minTime) {
+            guard try compressed.lunzipped()?.count == size else {
+                throw BenchmarkError.roundTrip
+            }
+        }
+    }
+    
+    return Result(operation: operation,
+                  corpus: corpus.rawValue,
+                  level: levelIndex,
+                  size: size,
+                  compressedSize: compressedSize,
+                  iterations: timing.iterations,
+                  seconds: timing.seconds,
+                  mbPerSecond: Double(size) / timing.seconds / 1e6,
+                  peakRSS: peakRSS(),
+                  baselineRSS: baseline,
+                  environment: Environment.current)
+}
+
+struct SteadyStateResult: Codable {
+    let operation: String
+    let level: Int
+    let chunkSize: Int
+    let chunks: Int
+    /// Allocation calls per chunk once the loop is warm, where they are counted
+    /// (glibc, through interposed allocation functions); expected to be 0
+    let allocationsPerChunk: Double?
+    /// Growth of live heap bytes per chunk; expected to be 0
+    let heapBytesPerChunk: Double
+    /// Growth of live heap blocks per chunk, where the allocator reports it (Darwin)
+    let heapBlocksPerChunk: Double?
+    let mbPerSecond: Double
+    let environment: Environment
+}
+
+/// Allocation calls so far and live heap blocks, each where available, and live heap
+/// bytes; see LzSwiftHeapCounters
+func heapStats() -> (allocations: Int?, blocks: Int?, bytes: Int) {
+    let stats = lzswift_heap_stats_read()
+    return (stats.allocations >= 0 ? Int(stats.allocations) : nil,
+            stats.blocks >= 0 ? Int(stats.blocks) : nil,
+            Int(stats.bytes))
+}
+
+/// Change per chunk between two optional counters
+func perChunk(_ before: Int?, _ after: Int?, chunks: Int) -> Double? {
+    guard let before = before, let after = after else { return nil }
+    return Double(after - before) / Double(chunks)
+}
+
+/// Streams `chunks` chunks through the sink APIs after a warm-up that lets the read
+/// buffer reach its final size, and reports how much the heap grew meanwhile.
+func runSteadyState(levelIndex: Int, chunkSize: Int, chunks: Int) throws -> [SteadyStateResult] {
+    let warmup = 64
+    let level = Lzip.CompressionLevel.allCases[levelIndex]
+    let input = generate(.text, size: chunkSize * (warmup + chunks))
+    guard let compressed = try input.lzipped(level: level) else { throw BenchmarkError.roundTrip }
+    var produced = 0
+    let sink = { (chunk: UnsafeRawBufferPointer) -> Void in
+        produced += chunk.count
+    }
+    
+    func steady(_ operation: String,
+                _ source: Data,
+                _ step: (UnsafeRawBufferPointer) throws -> Void) rethrows -> SteadyStateResult {
+        let size = source.count / (warmup + chunks)
+        return try source.withUnsafeBytes { (bytes: UnsafeRawBufferPointer) -> SteadyStateResult in
+            for i in 0..<warmup {
+                try step(UnsafeRawBufferPointer(rebasing: bytes[(i * size)..<((i + 1) * size)]))
+            }
+            let before = heapStats()
+            let start = now()
+            for i in warmup..<(warmup + chunks) {
+                try step(UnsafeRawBufferPointer(rebasing: bytes[(i * size)..<((i + 1) * size)]))
+            }
+            let seconds = now() - start
+            let after = heapStats()
+            
+            return SteadyStateResult(operation: operation,
+                                     level: levelIndex,
+                                     chunkSize: size,
+                                     chunks: chunks,
+                                     allocationsPerChunk: perChunk(before.allocations, after.allocations, chunks: chunks),
+                                     heapBytesPerChunk: Double(after.bytes - before.bytes) / Double(chunks),
+                                     heapBlocksPerChunk: perChunk(before.blocks, after.blocks, chunks: chunks),
+                                     mbPerSecond: Double(size * chunks) / seconds / 1e6,
+                                     environment: Environment.current)
+        }
+    }
+    
+    let compressor = Lzip.Compress(level: level)
+    let decompressor = Lzip.Decompress()
+    return [
+        try steady("compress-steady", input) { try compressor.compress(input: $0, sink: sink) },
+        try steady("decompress-steady", compressed) { try decompressor.decompress(input: $0, sink: sink) },
+    ]
+}
+
+struct Comparison: Codable {
+    let operation: String
+    let corpus: String
+    let level: Int
+    let size: Int
+    let baseMBPerSecond: Double
+    let otherMBPerSecond: Double
+    /// Other throughput over base throughput
+    let speedup: Double
+    let base: Environment?
+    let other: Environment?
+}
+
+/// Matches up the case results of two runs; steady-state results are skipped
+func compare(_ baseURL: URL, _ otherURL: URL) throws -> [Comparison] {
+    func load(_ url: URL) throws -> [String: Result] {
+        var results = [String: Result]()
+        for line in try String(contentsOf: url, encoding: .utf8).split(separator: "\n") {
+            if let result = try? JSONDecoder().decode(Result.self, from: Data(line.utf8)) {
+                results[result.key] = result
+            }
+        }
+        return results
+    }
+    
+    let base = try load(baseURL)
+    let other = try load(otherURL)
+    return base.keys.sorted().compactMap { key -> Comparison? in
+        guard let baseResult = base[key], let otherResult = other[key] else { return nil }
+        return Comparison(operation: baseResult.operation,
+                          corpus: baseResult.corpus,
+                          level: baseResult.level,
+                          size: baseResult.size,
+                          baseMBPerSecond: baseResult.mbPerSecond,
+                          otherMBPerSecond: otherResult.mbPerSecond,
+                          speedup: otherResult.mbPerSecond / baseResult.mbPerSecond,
+                          base: baseResult.environment,
+                          other: otherResult.environment)
+    }
+}
+
+func parseSize(_ text: Substring) -> Int? {
+    let units: [Character: Int] = ["K": 1 << 10, "M": 1 << 20, "G": 1 << 30]
+    if let last = text.last, let unit = units[last] {
+        return Int(text.dropLast()).map { $0 * unit }
+    }
+    return Int(text)
+}
+
+func option(_ name: String) -> [Substring]? {
+    guard let i = CommandLine.arguments.firstIndex(of: name), i + 1 < CommandLine.arguments.count else {
+        return nil
+    }
+    return CommandLine.arguments[i + 1].split(separator: ",")
+}
+
+let encoder = JSONEncoder()
+if #available(macOS 10.13, iOS 11.0, tvOS 11.0, watchOS 4.0, *) {
+    encoder.outputFormatting = .sortedKeys
+}
+
+if let i = CommandLine.arguments.firstIndex(of: "--compare"), i + 2 < CommandLine.arguments.count {
+    do {
+        for comparison in try compare(URL(fileURLWithPath: CommandLine.arguments[i + 1]),
+                                      URL(fileURLWithPath: CommandLine.arguments[i + 2])) {
+            print(String(decoding: try encoder.encode(comparison), as: UTF8.self))
+        }
+        exit(0)
+    } catch {
+        FileHandle.standardError.write("\(error)\n".data(using: .utf8)!)
+        exit(1)
+    }
+}
+
+let minTime = option("--min-time").flatMap { Double($0[0]) } ?? 1.0
+
+// Child process: run a single case and report it
+if let i = CommandLine.arguments.firstIndex(of: "--case"), i + 4 < CommandLine.arguments.count {
+    let arguments = CommandLine.arguments[(i + 1)...(i + 4)].map { $0 }
+    guard let corpus = Corpus(rawValue: arguments[1]),
+          let level = Int(arguments[2]),
+          let size = Int(arguments[3]) else {
+        exit(2)
+    }
+    do {
+        let result = try runCase(operation: arguments[0],
+                                 corpus: corpus,
+                                 levelIndex: level,
+                                 size: size,
+                                 minTime: minTime)
+        print(String(decoding: try encoder.encode(result), as: UTF8.self))
+        exit(0)
+    } catch {
+        FileHandle.standardError.write("\(error)\n".data(using: .utf8)!)
+        exit(1)
+    }
+}
+
+let levels = option("--levels")?.compactMap { Int($0) }.filter { Lzip.CompressionLevel.allCases.indices.contains($0) } ??
+    Array(Lzip.CompressionLevel.allCases.indices)
+let sizes = option("--sizes")?.compactMap(parseSize) ??
+    [1 << 10, 64 << 10, 1 << 20, 16 << 20, 256 << 20, 1 << 30]
+let corpora = option("--corpora")?.compactMap { Corpus(rawValue: String($0)) } ??
+    Corpus.allCases
+
+// In-process check that the streaming loops stop allocating once warm
+if CommandLine.arguments.contains("--steady-state") {
+    do {
+        for level in levels {
+            for result in try runSteadyState(levelIndex: level, chunkSize: 64 * 1024, chunks: 1024) {
+                print(String(decoding: try encoder.encode(result), as: UTF8.self))
+            }
+        }
+        exit(0)
+    } catch {
+        FileHandle.standardError.write("\(error)\n".data(using: .utf8)!)
+        exit(1)
+    }
+}
+
+let executable = Bundle.main.executableURL ?? URL(fileURLWithPath: CommandLine.arguments[0])
+
+for corpus in corpora {
+    for size in sizes {
+        for level in levels {
+            for operation in ["compress", "decompress"] {
+                let process = Process()
+                let pipe = Pipe()
+                process.executableURL = executable
+                process.arguments = ["--case", operation, corpus.rawValue, String(level), String(size),
+                                     "--min-time", String(minTime)]
+                process.standardOutput = pipe
+                
+                do {
+                    try process.run()
+                    let output = pipe.fileHandleForReading.readDataToEndOfFile()
+                    process.waitUntilExit()
+                    guard process.terminationStatus == 0 else {
+                        FileHandle.standardError.write("\(operation) \(corpus) level \(level) size \(size) failed\n".data(using: .utf8)!)
+                        continue
+                    }
+                    FileHandle.standardOutput.write(output)
+                } catch {
+                    FileHandle.standardError.write("\(error)\n".data(using: .utf8)!)
+                    exit(1)
+                }
+            }
+        }
+    }
+}
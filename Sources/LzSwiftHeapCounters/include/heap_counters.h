@@ -0,0 +1,19 @@
+#ifndef LZSWIFT_HEAP_COUNTERS_H
+#define LZSWIFT_HEAP_COUNTERS_H
+
+#include <stdint.h>
+
+/* Allocator statistics for the benchmarks' steady-state check. */
+typedef struct {
+    /* Allocation calls (malloc, calloc, realloc, memalign and friends) since start,
+       or -1 where they are not counted */
+    int64_t allocations;
+    /* Live heap blocks, or -1 where the allocator does not report them */
+    int64_t blocks;
+    /* Live heap bytes */
+    int64_t bytes;
+} lzswift_heap_stats;
+
+lzswift_heap_stats lzswift_heap_stats_read(void);
+
+#endif
@@ -15,7 +15,972 @@ final class LzSwiftTests: XCTestCase {
         XCTAssertEqual(original, uncompressed)
     }
     
+    func testParallelCompression() {
+        guard let sentence = lorem.data(using: .utf8) else { return XCTAssert(false) }
+        var original = Data()
+        for i in 0..<2000 {
+            original.append(sentence)
+            original.append(contentsOf: String(i).utf8)
+        }
+        
+        guard let compressed = try? original.lzipped(level: .lvl6, threads: 4, blockSize: 64 * 1024) else { return XCTAssert(false) }
+        XCTAssert(compressed.isLzipped)
+        
+        guard let uncompressed = try? compressed.lunzipped() else { return XCTAssert(false) }
+        XCTAssertEqual(original, uncompressed)
+    }
+    
+    func testParallelDecompression() {
+        guard let sentence = lorem.data(using: .utf8) else { return XCTAssert(false) }
+        var original = Data()
+        for i in 0..<2000 {
+            original.append(sentence)
+            original.append(contentsOf: String(i).utf8)
+        }
+        
+        guard let compressed = try? original.lzipped(level: .lvl2, threads: 4, blockSize: 64 * 1024) else { return XCTAssert(false) }
+        guard let index = try? Lzip.Index(compressed) else { return XCTAssert(false) }
+        XCTAssertEqual(index.members.count, (original.count + 64 * 1024 - 1) / (64 * 1024))
+        XCTAssertEqual(index.dataSize, original.count)
+        
+        guard let uncompressed = try? compressed.lunzipped(threads: 4) else { return XCTAssert(false) }
+        XCTAssertEqual(original, uncompressed)
+        
+        // Unindexable input behaves as with lunzipped(): trailing data is ignored and
+        // truncation throws instead of returning partial data
+        XCTAssertEqual(try (compressed + Data([0x00, 0x01, 0x02, 0x03])).lunzipped(threads: 4), original)
+        XCTAssertThrowsError(try compressed.prefix(compressed.count - 10).lunzipped(threads: 4)) { error in
+            XCTAssertEqual((error as? Lzip.Error)?.kind, .eof)
+        }
+    }
+    
+    func testBufferCompression() {
+        guard let original = lorem.data(using: .utf8) else { return XCTAssert(false) }
+        
+        var compressed = [UInt8](repeating: 0, count: 1024)
+        var uncompressed = [UInt8](repeating: 0, count: original.count)
+        
+        do {
+            let compressedCount = try original.withUnsafeBytes { (input: UnsafeRawBufferPointer) in
+                try compressed.withUnsafeMutableBytes { output in
+                    try Lzip.Compress(level: .lvl6).compress(input: input, into: output)
+                }
+            }
+            XCTAssert(compressedCount > 0)
+            
+            let uncompressedCount = try compressed.withUnsafeBytes { (input: UnsafeRawBufferPointer) in
+                try uncompressed.withUnsafeMutableBytes { output in
+                    try Lzip.Decompress().decompress(input: UnsafeRawBufferPointer(rebasing: input[0..<compressedCount]),
+                                                     into: output)
+                }
+            }
+            XCTAssertEqual(uncompressedCount, original.count)
+            XCTAssertEqual(original, Data(uncompressed))
+        } catch {
+            XCTAssert(false, "\(error)")
+        }
+        
+        // A destination that is too small is reported rather than truncated
+        var tooSmall = [UInt8](repeating: 0, count: 16)
+        XCTAssertThrowsError(try original.withUnsafeBytes { (input: UnsafeRawBufferPointer) in
+            try tooSmall.withUnsafeMutableBytes { output in
+                try Lzip.Compress(level: .lvl6).compress(input: input, into: output)
+            }
+        }) { error in
+            XCTAssertEqual((error as? Lzip.Error)?.kind, .overflow)
+        }
+    }
+    
+    func testSinkDecompression() {
+        guard let original = lorem.data(using: .utf8) else { return XCTAssert(false) }
+        guard let compressed = try? original.lzipped(level: .lvl6) else { return XCTAssert(false) }
+        
+        var uncompressed = [UInt8]()
+        let decompressor = Lzip.Decompress()
+        do {
+            var count = try compressed.withUnsafeBytes { (input: UnsafeRawBufferPointer) in
+                try decompressor.decompress(input: input) { chunk in
+                    uncompressed.append(contentsOf: chunk)
+                }
+            }
+            count += try decompressor.finish { chunk in
+                uncompressed.append(contentsOf: chunk)
+            }
+            XCTAssertEqual(count, original.count)
+            XCTAssertEqual(original, Data(uncompressed))
+        } catch {
+            XCTAssert(false, "\(error)")
+        }
+    }
+    
+    func testMaxCompressedSize() {
+        var generator = SystemRandomNumberGenerator()
+        let random = Data((0..<256 * 1024).map { _ in UInt8.random(in: 0...255, using: &generator) })
+        
+        guard let compressed = try? random.lzipped(level: .lvl9) else { return XCTAssert(false) }
+        XCTAssert(compressed.count <= Lzip.maxCompressedSize(for: random.count))
+        
+        guard let empty = try? Data().lzipped(level: .lvl0) else { return XCTAssert(false) }
+        XCTAssert(empty.count <= Lzip.maxCompressedSize(for: 0))
+    }
+    
+    func testContextReuse() {
+        guard let original = lorem.data(using: .utf8) else { return XCTAssert(false) }
+        
+        let compressor = Lzip.Compress(level: .lvl6)
+        let decompressor = Lzip.Decompress()
+        
+        for i in 0..<3 {
+            var message = original
+            message.append(contentsOf: String(i).utf8)
+            
+            do {
+                try compressor.reset()
+                var compressed = Data()
+                try compressor.compress(input: message, output: &compressed)
+                try compressor.finish(output: &compressed)
+                
+                // Every stream stands on its own
+                XCTAssertEqual(try compressed.lunzipped(), message)
+                
+                try decompressor.reset()
+                var uncompressed = Data()
+                try decompressor.decompress(input: compressed, output: &uncompressed)
+                try decompressor.finish { chunk in
+                    uncompressed.append(contentsOf: chunk)
+                }
+                XCTAssertEqual(uncompressed, message)
+            } catch {
+                XCTAssert(false, "\(error)")
+            }
+        }
+    }
+    
+    func testPool() {
+        guard let original = lorem.data(using: .utf8) else { return XCTAssert(false) }
+        
+        let pool = Lzip.Pool(maxIdle: 1, shards: 1)
+        let compressor = pool.compressor(level: .lvl3)
+        
+        var compressed = Data()
+        XCTAssertNoThrow(try compressor.compress(input: original, output: &compressed))
+        XCTAssertNoThrow(try compressor.finish(output: &compressed))
+        pool.recycle(compressor)
+        
+        // The same, now reset, context comes back out
+        XCTAssert(pool.compressor(level: .lvl3) === compressor)
+        XCTAssert(pool.compressor(level: .lvl3) !== compressor)
+        
+        let uncompressed = pool.withDecompressor { decompressor -> Data in
+            var uncompressed = Data()
+            _ = try? decompressor.decompress(input: compressed, output: &uncompressed)
+            return uncompressed
+        }
+        XCTAssertEqual(original, uncompressed)
+        
+        // The limits hold across shards, and an idle context is found from any thread
+        let sharded = Lzip.Pool(maxIdle: 1, shards: 8)
+        let first = Lzip.Compress(level: .lvl1)
+        sharded.recycle(first)
+        let recycled = DispatchGroup()
+        DispatchQueue.global().async(group: recycled) {
+            sharded.recycle(Lzip.Compress(level: .lvl1))
+        }
+        recycled.wait()
+        var found: Lzip.Compress?
+        let taken = DispatchGroup()
+        DispatchQueue.global().async(group: taken) {
+            found = sharded.compressor(level: .lvl1)
+        }
+        taken.wait()
+        XCTAssert(found === first)
+        XCTAssert(sharded.compressor(level: .lvl1) !== first)
+        
+        let small = Lzip.Pool(maxIdle: 4, memoryLimit: first.memoryFootprint, shards: 8)
+        small.recycle(first)
+        small.recycle(Lzip.Compress(level: .lvl1))
+        XCTAssert(small.compressor(level: .lvl1) === first)
+        XCTAssert(small.compressor(level: .lvl1) !== first)
+        
+        // maxIdle counts a level's compressors together, whatever their dictionary size
+        let levels = Lzip.Pool(maxIdle: 1, shards: 1)
+        let tiny = Lzip.Compress(parameters: Lzip.Parameters(level: .lvl6, inputSize: 100))
+        let medium = Lzip.Compress(parameters: Lzip.Parameters(level: .lvl6, inputSize: 100 << 10))
+        levels.recycle(tiny)
+        levels.recycle(medium)
+        XCTAssert(levels.compressor(parameters: Lzip.Parameters(level: .lvl6, inputSize: 200)) === tiny)
+        XCTAssert(levels.compressor(parameters: Lzip.Parameters(level: .lvl6, inputSize: 200 << 10)) !== medium)
+    }
+    
+    func testAdaptiveBufferSize() {
+        guard let sentence = lorem.data(using: .utf8) else { return XCTAssert(false) }
+        var original = Data()
+        while original.count < 1024 * 1024 {
+            original.append(sentence)
+        }
+        guard let compressed = try? original.lzipped(level: .lvl6) else { return XCTAssert(false) }
+        
+        let fixed = Lzip.Decompress(bufferSize: .fixed(4096))
+        let adaptive = Lzip.Decompress(bufferSize: .adaptive(initial: 4096, maximum: 256 * 1024))
+        
+        for (decompressor, expectedLargestChunk) in [(fixed, 4096), (adaptive, 256 * 1024)] {
+            var uncompressed = Data()
+            var largestChunk = 0
+            XCTAssertNoThrow(try compressed.withUnsafeBytes { (input: UnsafeRawBufferPointer) in
+                try decompressor.decompress(input: input) { chunk in
+                    largestChunk = max(largestChunk, chunk.count)
+                    uncompressed.append(contentsOf: chunk)
+                }
+            })
+            XCTAssertEqual(largestChunk, expectedLargestChunk)
+            XCTAssertEqual(original, uncompressed)
+        }
+    }
+    
+    func testFileCompression() {
+        guard let sentence = lorem.data(using: .utf8) else { return XCTAssert(false) }
+        var original = Data()
+        for i in 0..<4000 {
+            original.append(sentence)
+            original.append(contentsOf: String(i).utf8)
+        }
+        
+        let directory = URL(fileURLWithPath: NSTemporaryDirectory())
+        let source = directory.appendingPathComponent("LzSwiftTests-source")
+        let compressed = directory.appendingPathComponent("LzSwiftTests-source.lz")
+        let uncompressed = directory.appendingPathComponent("LzSwiftTests-uncompressed")
+        defer {
+            try? FileManager.default.removeItem(at: source)
+            try? FileManager.default.removeItem(at: compressed)
+            try? FileManager.default.removeItem(at: uncompressed)
+        }
+        
+        for threads in [1, 4] {
+            do {
+                try original.write(to: source)
+                try Lzip.compressFile(at: source, to: compressed, level: .lvl1, threads: threads)
+                try Lzip.decompressFile(at: compressed, to: uncompressed, threads: threads)
+                XCTAssertEqual(try Data(contentsOf: uncompressed), original)
+                
+                // Trailing data is ignored, as by Data.lunzipped()
+                try (try Data(contentsOf: compressed) + Data([0x00, 0x01, 0x02, 0x03])).write(to: compressed)
+                try Lzip.decompressFile(at: compressed, to: uncompressed, threads: threads)
+                XCTAssertEqual(try Data(contentsOf: uncompressed), original)
+            } catch {
+                XCTAssert(false, "\(error)")
+            }
+        }
+    }
+    
+    func testAsyncStreaming() {
+        #if compiler(>=5.5) && canImport(_Concurrency)
+        guard #available(macOS 10.15, iOS 13.0, tvOS 13.0, watchOS 6.0, *) else { return }
+        guard let sentence = lorem.data(using: .utf8) else { return XCTAssert(false) }
+        var original = Data()
+        for i in 0..<1000 {
+            original.append(sentence)
+            original.append(contentsOf: String(i).utf8)
+        }
+        let chunks = stride(from: 0, to: original.count, by: 4096).map {
+            original[$0..<min($0 + 4096, original.count)]
+        }
+        
+        let done = expectation(description: "async round trip")
+        Task {
+            let upstream = AsyncStream<Data> { continuation in
+                for chunk in chunks {
+                    continuation.yield(chunk)
+                }
+                continuation.finish()
+            }
+            
+            var uncompressed = Data()
+            do {
+                for try await chunk in upstream.lzipped(level: .lvl6).lunzipped() {
+                    uncompressed.append(chunk)
+                }
+            } catch {
+                XCTAssert(false, "\(error)")
+            }
+            XCTAssertEqual(original, uncompressed)
+            done.fulfill()
+        }
+        wait(for: [done], timeout: 30)
+        #endif
+    }
+    
+    func testPushPullStream() {
+        guard let original = lorem.data(using: .utf8) else { return XCTAssert(false) }
+        
+        func pump(_ stream: LzipStream, _ input: Data) throws -> Data {
+            var output = Data()
+            var chunk = [UInt8](repeating: 0, count: 64)
+            let drain = {
+                while true {
+                    let read = try chunk.withUnsafeMutableBytes { try stream.read(into: $0) }
+                    if read == 0 {
+                        return
+                    }
+                    output.append(contentsOf: chunk[0..<read])
+                }
+            }
+            
+            var offset = 0
+            while offset < input.count {
+                offset += try input[offset...].withUnsafeBytes { (bytes: UnsafeRawBufferPointer) in
+                    try stream.write(UnsafeRawBufferPointer(rebasing: bytes.prefix(100)))
+                }
+                try drain()
+            }
+            try stream.finish()
+            try drain()
+            return output
+        }
+        
+        do {
+            let compressed = try pump(Lzip.Compress(level: .lvl1), original)
+            XCTAssert(compressed.isLzipped)
+            XCTAssertEqual(try pump(Lzip.Decompress(), compressed), original)
+        } catch {
+            XCTAssert(false, "\(error)")
+        }
+    }
+    
+    func testSyncFlush() {
+        let compressor = Lzip.Compress(level: .lvl6)
+        let decompressor = Lzip.Decompress()
+        var uncompressed = Data()
+        
+        do {
+            for i in 0..<5 {
+                guard let record = "\(lorem) \(i)".data(using: .utf8) else { return XCTAssert(false) }
+                
+                var compressed = Data()
+                try compressor.compress(input: record, output: &compressed)
+                try compressor.flush(output: &compressed)
+                
+                // Each record decodes in full before the member is closed
+                let before = uncompressed.count
+                try decompressor.decompress(input: compressed, output: &uncompressed)
+                XCTAssertEqual(uncompressed[before...], record)
+            }
+        } catch {
+            XCTAssert(false, "\(error)")
+        }
+    }
+    
+    func testSeekableRead() {
+        guard let sentence = lorem.data(using: .utf8) else { return XCTAssert(false) }
+        var original = Data()
+        for i in 0..<2000 {
+            original.append(sentence)
+            original.append(contentsOf: String(i).utf8)
+        }
+        
+        do {
+            let compressed = try original.lzipped(level: .lvl1, threads: 4, blockSize: 64 * 1024)
+            let reader = try Lzip.SeekableReader(data: compressed)
+            XCTAssert(reader.index.members.count > 1)
+            XCTAssertEqual(reader.count, original.count)
+            
+            // Within one member, across a member boundary, and clipped at the end
+            let boundary = reader.index.members[1].dataOffset
+            XCTAssertEqual(try reader.read(offset: 1000, length: 500), original[1000..<1500])
+            XCTAssertEqual(try reader.read(offset: boundary - 100, length: 200), original[(boundary - 100)..<(boundary + 100)])
+            XCTAssertEqual(try reader.read(offset: original.count - 10, length: 100), original[(original.count - 10)...])
+            XCTAssertEqual(try reader.read(offset: original.count, length: 10), Data())
+            
+            let url = URL(fileURLWithPath: NSTemporaryDirectory()).appendingPathComponent("LzSwiftSeekable.lz")
+            let indexURL = url.appendingPathExtension("idx")
+            defer {
+                try? FileManager.default.removeItem(at: url)
+                try? FileManager.default.removeItem(at: indexURL)
+            }
+            try compressed.write(to: url)
+            _ = try Lzip.SeekableReader(contentsOf: url, cacheIndex: true)
+            XCTAssert(FileManager.default.fileExists(atPath: indexURL.path))
+            
+            let cached = try Lzip.SeekableReader(contentsOf: url, cacheIndex: true)
+            XCTAssertEqual(cached.index, reader.index)
+            XCTAssertEqual(try cached.read(offset: boundary, length: 64), original[boundary..<(boundary + 64)])
+            XCTAssertEqual(try cached.read(offset: boundary, length: Int.max), original[boundary...])
+            
+            // A cache for another version of the file, or one that does not fit it, is
+            // rebuilt, not trusted
+            let stored = try JSONDecoder().decode(Lzip.SeekableReader.CachedIndex.self, from: Data(contentsOf: indexURL))
+            let members = reader.index.members
+            let shifted = members.enumerated().map { memberIdx, member in
+                Lzip.Member(offset: member.offset,
+                            size: member.size,
+                            dataOffset: memberIdx == 1 ? member.dataOffset + 1 : member.dataOffset,
+                            dataSize: member.dataSize,
+                            crc: member.crc,
+                            version: member.version,
+                            dictionarySize: member.dictionarySize)
+            }
+            let shiftedIndex = try JSONDecoder().decode(Lzip.Index.self, from: JSONEncoder().encode(["members": shifted]))
+            for cache in [Lzip.SeekableReader.CachedIndex(fileSize: stored.fileSize, modified: stored.modified, index: shiftedIndex),
+                          Lzip.SeekableReader.CachedIndex(fileSize: stored.fileSize, modified: stored.modified - 1, index: stored.index),
+                          Lzip.SeekableReader.CachedIndex(fileSize: stored.fileSize + 1, modified: stored.modified, index: stored.index)] {
+                try JSONEncoder().encode(cache).write(to: indexURL)
+                XCTAssertEqual(try Lzip.SeekableReader(contentsOf: url, cacheIndex: true).index, reader.index)
+                let rewritten = try JSONDecoder().decode(Lzip.SeekableReader.CachedIndex.self, from: Data(contentsOf: indexURL))
+                XCTAssertEqual(rewritten.fileSize, stored.fileSize)
+                XCTAssertEqual(rewritten.modified, stored.modified)
+                XCTAssertEqual(rewritten.index, reader.index)
+            }
+        } catch {
+            XCTAssert(false, "\(error)")
+        }
+    }
+    
+    func testBatchCompression() {
+        let records = (0..<500).map { i in
+            "\(i) \(lorem.prefix(i % 400))".data(using: .utf8)!
+        }
+        
+        do {
+            let batch = try Lzip.compress(batch: records, level: .lvl1, threads: 4)
+            XCTAssertEqual(batch.count, records.count)
+            XCTAssertEqual(batch.ranges.last?.upperBound, batch.storage.count)
+            for (record, compressed) in zip(records, batch) {
+                XCTAssert(compressed.isLzipped)
+                XCTAssertEqual(try compressed.lunzipped(), record)
+            }
+            XCTAssertEqual(try Lzip.compress(batch: [], level: .lvl1).count, 0)
+        } catch {
+            XCTAssert(false, "\(error)")
+        }
+    }
+    
+    func testProgressHandler() {
+        guard let sentence = lorem.data(using: .utf8) else { return XCTAssert(false) }
+        var original = Data()
+        for i in 0..<2000 {
+            original.append(sentence)
+            original.append(contentsOf: String(i).utf8)
+        }
+        
+        let compressor = Lzip.Compress(level: .lvl1)
+        var reports = [Lzip.Progress]()
+        compressor.setProgressHandler(interval: 64 * 1024) { progress in
+            reports.append(progress)
+            return true
+        }
+        
+        var compressed = Data()
+        do {
+            try compressor.compress(input: original, output: &compressed)
+            try compressor.finish { compressed.append($0.bindMemory(to: UInt8.self)) }
+        } catch {
+            return XCTAssert(false, "\(error)")
+        }
+        XCTAssert(reports.count > 1)
+        XCTAssertEqual(reports.last?.totalIn, original.count)
+        XCTAssertEqual(reports.last?.totalOut, compressed.count)
+        XCTAssert((reports.last?.ratio ?? 1) < 0.5)
+        
+        // Cancelling stops the job with .cancelled
+        let decompressor = Lzip.Decompress()
+        decompressor.setProgressHandler(interval: 1024) { _ in false }
+        var output = Data()
+        XCTAssertThrowsError(try decompressor.decompress(input: compressed, output: &output)) { error in
+            XCTAssertEqual((error as? Lzip.Error)?.kind, .cancelled)
+        }
+        
+        // finish(output:) reports the final progress and surfaces a cancel
+        let cancelling = Lzip.Compress(level: .lvl1)
+        cancelling.setProgressHandler(interval: 1 << 30) { _ in false }
+        var cancelled = Data()
+        XCTAssertNoThrow(try cancelling.compress(input: sentence, output: &cancelled))
+        XCTAssertThrowsError(try cancelling.finish(output: &cancelled)) { error in
+            XCTAssertEqual((error as? Lzip.Error)?.kind, .cancelled)
+        }
+    }
+    
+    func testParameters() {
+        guard let original = lorem.data(using: .utf8) else { return XCTAssert(false) }
+        
+        XCTAssertThrowsError(try Lzip.Parameters(dictionarySize: 1024, matchLenLimit: 36)) { error in
+            XCTAssertEqual((error as? Lzip.Error)?.kind, .argument)
+        }
+        XCTAssertThrowsError(try Lzip.Parameters(dictionarySize: 1 << 20, matchLenLimit: 1000))
+        
+        // The dictionary is capped to the first size bucket that holds the input
+        XCTAssertEqual(Lzip.Parameters(level: .lvl9, inputSize: 100 * 1024).dictionarySize, 1 << 20)
+        XCTAssertEqual(Lzip.Parameters(level: .lvl9, inputSize: 10).dictionarySize, 64 << 10)
+        XCTAssertEqual(Lzip.Parameters(level: .lvl9, inputSize: 4 << 20).dictionarySize, 8 << 20)
+        XCTAssertEqual(Lzip.Parameters(level: .lvl2, inputSize: 1 << 20).dictionarySize, 1 << 19)
+        XCTAssertEqual(Lzip.Parameters(level: .lvl1, inputSize: 1 << 30), Lzip.Parameters(level: .lvl1))
+        XCTAssertEqual(Lzip.Parameters(level: .lvl0, inputSize: 10), Lzip.Parameters(level: .lvl0))
+        
+        do {
+            let parameters = try Lzip.Parameters(dictionarySize: 1 << 16, matchLenLimit: 100)
+            let compressor = Lzip.Compress(parameters: parameters)
+            var compressed = Data()
+            try compressor.compress(input: original, output: &compressed)
+            try compressor.finish(output: &compressed)
+            XCTAssertEqual(try compressed.lunzipped(), original)
+            
+            let index = try Lzip.Index(compressed)
+            XCTAssertEqual(index.members.first?.dictionarySize, 1 << 16)
+            
+            // Compressors with custom parameters are pooled under those parameters
+            let pool = Lzip.Pool(maxIdle: 1, shards: 1)
+            pool.recycle(compressor)
+            XCTAssert(pool.compressor(parameters: parameters) === compressor)
+        } catch {
+            XCTAssert(false, "\(error)")
+        }
+    }
+    
+    func testPrecheck() {
+        guard let sentence = lorem.data(using: .utf8) else { return XCTAssert(false) }
+        var text = Data()
+        for i in 0..<500 {
+            text.append(sentence)
+            text.append(contentsOf: String(i).utf8)
+        }
+        var generator = SystemRandomNumberGenerator()
+        let noise = Data((0..<(256 * 1024)).map { _ in UInt8.random(in: 0...255, using: &generator) })
+        
+        do {
+            let (compressedText, textCheck) = try text.lzipped(adaptiveLevel: .lvl6)
+            XCTAssert(textCheck.isCompressible)
+            XCTAssertEqual(textCheck.level, .lvl6)
+            XCTAssertEqual(try compressedText.lunzipped(), text)
+            
+            let (compressedNoise, noiseCheck) = try noise.lzipped(adaptiveLevel: .lvl6)
+            XCTAssertFalse(noiseCheck.isCompressible)
+            XCTAssertEqual(noiseCheck.level, .lvl0)
+            XCTAssert(noiseCheck.entropy > 7.9)
+            XCTAssertEqual(try compressedNoise.lunzipped(), noise)
+        } catch {
+            XCTAssert(false, "\(error)")
+        }
+    }
+    
+    func testDecompressOptions() {
+        guard let first = lorem.data(using: .utf8),
+              let second = "\(lorem) again".data(using: .utf8),
+              var stream = try? first.lzipped(level: .lvl1),
+              let member = try? second.lzipped(level: .lvl1) else { return XCTAssert(false) }
+        stream.append(member)
+        let original = first + second
+        
+        do {
+            // Trailing data is ignored by default, unless it looks like a corrupt header
+            var trailing = stream
+            trailing.append(contentsOf: [0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07])
+            XCTAssertEqual(try trailing.lunzipped(), original)
+            XCTAssertThrowsError(try trailing.lunzipped(options: .init(trailingData: .error)))
+            XCTAssertThrowsError(try (stream + Data([0x4c, 0x5a, 0x49])).lunzipped())
+            let outcome = try trailing.withUnsafeBytes { (input: UnsafeRawBufferPointer) in
+                try Lzip.Decompress().decompress(input: input, options: .default) { _ in }
+            }
+            XCTAssertEqual(outcome.trailingSize, 8)
+            XCTAssertEqual(outcome.inputSize, trailing.count - 8)
+            
+            // Early termination
+            XCTAssertEqual(try stream.lunzipped(options: .init(multimember: false)), first)
+            XCTAssertEqual(try stream.lunzipped(options: .init(outputLimit: 100)), original.prefix(100))
+            
+            // Truncated input throws instead of returning partial data
+            XCTAssertThrowsError(try stream.prefix(stream.count - 10).lunzipped()) { error in
+                XCTAssertEqual((error as? Lzip.Error)?.kind, .eof)
+            }
+            
+            // A corrupt member is skipped with recover
+            var corrupt = stream
+            corrupt[corrupt.startIndex + 20] ^= 0xff
+            XCTAssertThrowsError(try corrupt.lunzipped())
+            let decompressor = Lzip.Decompress()
+            var output = Data()
+            let outcome = try corrupt.withUnsafeBytes { (input: UnsafeRawBufferPointer) in
+                try decompressor.decompress(input: input, options: .init(recover: true)) { chunk in
+                    output.append(chunk.bindMemory(to: UInt8.self))
+                }
+            }
+            XCTAssertEqual(outcome.stop, .finished)
+            XCTAssert(outcome.recoveries > 0)
+            XCTAssertEqual(output.suffix(second.count), second)
+        } catch {
+            XCTAssert(false, "\(error)")
+        }
+    }
+    
+    func testVerify() {
+        guard let sentence = lorem.data(using: .utf8) else { return XCTAssert(false) }
+        var original = Data()
+        for i in 0..<2000 {
+            original.append(sentence)
+            original.append(contentsOf: String(i).utf8)
+        }
+        
+        do {
+            var compressed = try original.lzipped(level: .lvl1, threads: 4, blockSize: 64 * 1024)!
+            let verification = try Lzip.verify(compressed, threads: 4)
+            XCTAssert(verification.isValid)
+            XCTAssertEqual(verification.members.count, try Lzip.Index(compressed).members.count)
+            XCTAssertEqual(verification.members.map { $0.dataSize }.reduce(0, +), original.count)
+            
+            // Damage the second member only
+            let second = try Lzip.Index(compressed).members[1]
+            compressed[second.offset + second.size / 2] ^= 0xff
+            let damaged = try Lzip.verify(compressed, threads: 4)
+            XCTAssertFalse(damaged.isValid)
+            XCTAssertEqual(damaged.members.filter { $0.isValid == false }.map { $0.member.offset }, [second.offset])
+        } catch {
+            XCTAssert(false, "\(error)")
+        }
+    }
+    
+    func testPipeline() {
+        guard let sentence = lorem.data(using: .utf8) else { return XCTAssert(false) }
+        var original = Data()
+        for i in 0..<2000 {
+            original.append(sentence)
+            original.append(contentsOf: String(i).utf8)
+        }
+        
+        // Feeds `input` in small reads, collecting whatever is written
+        func pipe(_ stream: LzipStream, _ input: Data) throws -> Data {
+            var offset = 0
+            var output = Data()
+            try Lzip.Pipeline(chunkSize: 4096, depth: 2).run(stream, read: { buffer in
+                let count = min(buffer.count, input.count - offset, 1000)
+                input.copyBytes(to: buffer.bindMemory(to: UInt8.self), from: offset..<(offset + count))
+                offset += count
+                return count
+            }, write: { bytes in
+                output.append(bytes.bindMemory(to: UInt8.self))
+            })
+            return output
+        }
+        
+        do {
+            let compressed = try pipe(Lzip.Compress(level: .lvl1), original)
+            XCTAssert(compressed.isLzipped)
+            XCTAssertEqual(try pipe(Lzip.Decompress(), compressed), original)
+            
+            XCTAssertThrowsError(try pipe(Lzip.Decompress(), compressed.prefix(compressed.count / 2))) { error in
+                XCTAssertEqual((error as? Lzip.Error)?.kind, .eof)
+            }
+        } catch {
+            XCTAssert(false, "\(error)")
+        }
+    }
+    
+    func testPresetDictionary() {
+        func message(_ i: Int) -> Data {
+            return "{\"id\": \(i), \"user\": \"user\(i % 7)\", \"event\": \"page_view\", \"path\": \"/catalog/items/\(i * 31)\", \"agent\": \"Mozilla/5.0 (X11; Linux x86_64)\"}".data(using: .utf8)!
+        }
+        var sample = Data()
+        for i in 0..<20 {
+            sample.append(message(1000 + i))
+        }
+        
+        do {
+            let dictionary = try Lzip.PresetDictionary(sample: sample, level: .lvl6)
+            for i in 0..<5 {
+                let original = message(i)
+                let frame = try dictionary.compress(original)
+                XCTAssert(frame.count < (try original.lzipped(level: .lvl6)?.count ?? 0))
+                XCTAssertEqual(try dictionary.decompress(frame), original)
+            }
+            
+            // A frame only decodes against the sample it was made with
+            let other = try Lzip.PresetDictionary(sample: message(42), level: .lvl6)
+            XCTAssertThrowsError(try other.decompress(try dictionary.compress(message(1))))
+        } catch {
+            XCTAssert(false, "\(error)")
+        }
+    }
+    
+    func testAsyncParallelCompression() {
+        #if compiler(>=5.5) && canImport(_Concurrency)
+        guard #available(macOS 10.15, iOS 13.0, tvOS 13.0, watchOS 6.0, *) else { return }
+        guard let sentence = lorem.data(using: .utf8) else { return XCTAssert(false) }
+        var original = Data()
+        for i in 0..<2000 {
+            original.append(sentence)
+            original.append(contentsOf: String(i).utf8)
+        }
+        let compressor = Lzip.ParallelCompress(level: .lvl1, blockSize: 64 * 1024, threads: 4)
+        
+        let done = expectation(description: "async parallel compression")
+        Task {
+            do {
+                var reports = [Lzip.Progress]()
+                let compressed = try await compressor.compress(input: original) { reports.append($0) }
+                XCTAssertEqual(try compressed.lunzipped(), original)
+                XCTAssertEqual(reports.count, try Lzip.Index(compressed).members.count)
+                XCTAssertEqual(reports.last?.totalIn, original.count)
+                XCTAssertEqual(reports.last?.totalOut, compressed.count)
+            } catch {
+                XCTAssert(false, "\(error)")
+            }
+            
+            // A cancelled job stops between blocks
+            let job = Task { try await compressor.compress(input: original) }
+            job.cancel()
+            do {
+                _ = try await job.value
+                XCTAssert(false, "not cancelled")
+            } catch {
+                XCTAssert(error is CancellationError)
+            }
+            done.fulfill()
+        }
+        wait(for: [done], timeout: 30)
+        #endif
+    }
+    
+    func testContiguousBytes() {
+        guard let sentence = lorem.data(using: .utf8) else { return XCTAssert(false) }
+        let original = [UInt8](sentence) + [UInt8](sentence)
+        
+        do {
+            let compressed = try original.lzipped(level: .lvl6)
+            XCTAssertEqual(Data(compressed), try Data(original).lzipped(level: .lvl6))
+            XCTAssertEqual(try compressed.lunzipped(), original)
+            
+            // Raw buffers in, any sink out, appending to what is already there
+            var output = Data([0x2a])
+            try original.withUnsafeBytes { (bytes: UnsafeRawBufferPointer) in
+                try bytes.lzipped(level: .lvl1, into: &output)
+            }
+            XCTAssertEqual(output.first, 0x2a)
+            var decoded = [UInt8]()
+            try output.dropFirst().lunzipped(into: &decoded)
+            XCTAssertEqual(decoded, original)
+            
+            XCTAssertThrowsError(try Array(compressed.dropLast(4)).lunzipped())
+        } catch {
+            XCTAssert(false, "\(error)")
+        }
+    }
+    
+    func testAutoTune() {
+        guard let sentence = lorem.data(using: .utf8) else { return XCTAssert(false) }
+        var original = Data()
+        for i in 0..<5000 {
+            original.append(sentence)
+            original.append(contentsOf: String(i).utf8)
+        }
+        let blockSize = 64 * 1024
+        XCTAssert(original.count > 10 * blockSize)
+        
+        do {
+            // No level is that fast, so every wave steps down until lvl0
+            var fast = Data()
+            let fastSteps = try Lzip.AutoTune(goal: .throughput(mbPerSecond: 1e9),
+                                              initialLevel: .lvl6,
+                                              blockSize: blockSize,
+                                              threads: 1).compress(input: original, output: &fast)
+            XCTAssertEqual(fastSteps.map { $0.level }.prefix(7), [.lvl6, .lvl5, .lvl4, .lvl3, .lvl2, .lvl1, .lvl0])
+            XCTAssertEqual(fastSteps.last?.level, .lvl0)
+            XCTAssertEqual(fastSteps.reduce(0) { $0 + $1.inputSize }, original.count)
+            XCTAssertEqual(fastSteps.reduce(0) { $0 + $1.outputSize }, fast.count)
+            XCTAssertEqual(try fast.lunzipped(), original)
+            
+            // An hour for under a megabyte leaves room for denser levels
+            var dense = Data()
+            let denseSteps = try Lzip.AutoTune(goal: .deadline(3600),
+                                               initialLevel: .lvl0,
+                                               blockSize: blockSize,
+                                               threads: 1).compress(input: original, output: &dense)
+            XCTAssertEqual(denseSteps.first?.level, .lvl0)
+            XCTAssertEqual(denseSteps.dropFirst().first?.level, .lvl1)
+            XCTAssertEqual(try dense.lunzipped(), original)
+            XCTAssert(dense.count < fast.count)
+        } catch {
+            XCTAssert(false, "\(error)")
+        }
+    }
+    
+    func testBoundedDecompression() {
+        guard let sentence = lorem.data(using: .utf8),
+              let small = try? sentence.lzipped(level: .lvl1) else { return XCTAssert(false) }
+        
+        do {
+            // A member declaring a 16 MiB dictionary for a few hundred bytes
+            let compressor = Lzip.Compress(parameters: try Lzip.Parameters(dictionarySize: 1 << 24, matchLenLimit: 36))
+            var large = Data()
+            try compressor.compress(input: sentence, output: &large)
+            try compressor.finish(output: &large)
+            XCTAssertEqual(try large.lunzipped(), sentence)
+            
+            let bounded = Lzip.Decompress.Options(dictionaryLimit: 1 << 20)
+            XCTAssertEqual(try small.lunzipped(options: bounded), sentence)
+            // Only the header has to be there for the limit to apply
+            for stream in [large, small + large, small + large.prefix(11)] {
+                XCTAssertThrowsError(try stream.lunzipped(options: bounded)) { error in
+                    XCTAssertEqual((error as? Lzip.Error)?.kind, .limit)
+                }
+            }
+            
+            // Output beyond maxOutputSize is an error, unlike outputLimit
+            XCTAssertEqual(try small.lunzipped(options: .init(maxOutputSize: sentence.count)), sentence)
+            XCTAssertThrowsError(try small.lunzipped(options: .init(maxOutputSize: sentence.count - 1))) { error in
+                XCTAssertEqual((error as? Lzip.Error)?.kind, .limit)
+            }
+            XCTAssertEqual(try small.lunzipped(options: .init(outputLimit: 10, maxOutputSize: 20)), sentence.prefix(10))
+        } catch {
+            XCTAssert(false, "\(error)")
+        }
+    }
+    
+    func testInspection() {
+        guard let first = lorem.data(using: .utf8),
+              let second = "\(lorem) again".data(using: .utf8),
+              var stream = try? first.lzipped(level: .lvl1),
+              let member = try? second.lzipped(level: .lvl6) else { return XCTAssert(false) }
+        stream.append(member)
+        
+        do {
+            let url = URL(fileURLWithPath: NSTemporaryDirectory()).appendingPathComponent("LzSwiftInspection.lz")
+            defer { try? FileManager.default.removeItem(at: url) }
+            try stream.write(to: url)
+            
+            let index = try Lzip.Index(contentsOf: url)
+            XCTAssertEqual(index, try Lzip.Index(stream))
+            XCTAssertEqual(index.members.count, 2)
+            XCTAssertEqual(index.members.map { $0.version }, [1, 1])
+            XCTAssertEqual(index.dataSize, first.count + second.count)
+            XCTAssertEqual(index.compressedSize, stream.count)
+            XCTAssertEqual(index.dictionarySize, index.members.map { $0.dictionarySize }.max())
+            XCTAssert(index.dictionarySize >= 4096)
+            XCTAssertEqual(index.ratio, Double(stream.count) / Double(first.count + second.count))
+            
+            XCTAssertThrowsError(try Lzip.Index(stream.dropLast()))
+        } catch {
+            XCTAssert(false, "\(error)")
+        }
+    }
+    
+    func testArchive() {
+        guard let sentence = lorem.data(using: .utf8) else { return XCTAssert(false) }
+        var large = Data()
+        for i in 0..<100 {
+            large.append(sentence)
+            large.append(contentsOf: String(i).utf8)
+        }
+        var files = [(path: String, contents: Data)]()
+        for i in 0..<200 {
+            files.append((path: "small/\(i).txt", contents: sentence.prefix(i % 64 + 1)))
+        }
+        files.append((path: "large.txt", contents: large))
+        files.append((path: "empty", contents: Data()))
+        
+        let fileManager = FileManager.default
+        let root = URL(fileURLWithPath: NSTemporaryDirectory()).appendingPathComponent("LzSwiftArchive")
+        defer { try? fileManager.removeItem(at: root) }
+        
+        do {
+            let archive = try Lzip.Archive.create(files.map { Lzip.Archive.Source(path: $0.path, contents: $0.contents) },
+                                                  level: .lvl6,
+                                                  memberSize: 8 * 1024,
+                                                  threads: 4)
+            XCTAssertEqual(try archive.lunzipped()?.prefix(1), sentence.prefix(1))
+            
+            // Small files share members, the large one spans several
+            let index = try Lzip.Index(archive)
+            XCTAssert(index.members.count < files.count / 4)
+            XCTAssert(index.members.count > large.count / (8 * 1024))
+            
+            let reader = try Lzip.ArchiveReader(data: archive)
+            XCTAssertEqual(reader.entries.map { $0.path }, files.map { $0.path })
+            for file in files {
+                XCTAssertEqual(try reader.contents(at: file.path), file.contents)
+            }
+            XCTAssertNil(try reader.contents(at: "missing"))
+            XCTAssertThrowsError(try Lzip.ArchiveReader(data: try large.lzipped(level: .lvl1) ?? Data()))
+            
+            // Duplicate paths are refused on both sides, and a crafted directory is an
+            // error, not a trap
+            XCTAssertThrowsError(try Lzip.Archive.create([Lzip.Archive.Source(path: "a", contents: sentence),
+                                                          Lzip.Archive.Source(path: "a", contents: sentence)],
+                                                         level: .lvl1)) { error in
+                XCTAssertEqual((error as? Lzip.Error)?.kind, .argument)
+            }
+            guard let contents = try sentence.lzipped(level: .lvl1) else { return XCTAssert(false) }
+            for entries in [[Lzip.Archive.Entry(path: "a", offset: 1, size: Int.max)],
+                            [Lzip.Archive.Entry(path: "a", offset: 0, size: 1), Lzip.Archive.Entry(path: "a", offset: 1, size: 1)]] {
+                let directory = try JSONEncoder().encode(Lzip.Archive.Directory(format: Lzip.Archive.format, entries: entries))
+                guard let directoryMember = try directory.lzipped(level: .lvl1) else { return XCTAssert(false) }
+                XCTAssertThrowsError(try Lzip.ArchiveReader(data: contents + directoryMember)) { error in
+                    XCTAssertEqual((error as? Lzip.Error)?.kind, .header)
+                }
+            }
+            
+            let extracted = root.appendingPathComponent("extracted")
+            try reader.extract(to: extracted)
+            for file in files {
+                XCTAssertEqual(try Data(contentsOf: extracted.appendingPathComponent(file.path)), file.contents)
+            }
+            
+            // Whole directories, read back through a file mapping
+            let archiveURL = root.appendingPathComponent("archive.lz")
+            try Lzip.Archive.create(directory: extracted, at: archiveURL, level: .lvl1, threads: 2)
+            let fileReader = try Lzip.ArchiveReader(contentsOf: archiveURL)
+            XCTAssertEqual(Set(fileReader.entries.map { $0.path }), Set(files.map { $0.path }))
+            XCTAssertEqual(try fileReader.contents(at: "small/7.txt"), sentence.prefix(8))
+            XCTAssertEqual(try fileReader.contents(at: "large.txt"), large)
+        } catch {
+            XCTAssert(false, "\(error)")
+        }
+    }
+    
+    func testCraftedTrailers() {
+        var state: UInt32 = 1
+        var random = Data()
+        for _ in 0..<(16 * 1024) {
+            state = state &* 1664525 &+ 1013904223
+            random.append(UInt8(truncatingIfNeeded: state >> 24))
+        }
+        guard var crafted = try? random.lzipped(level: .lvl0) else { return XCTAssert(false) }
+        
+        // A trailer claiming 8000:1, which the index accepts but nothing should reserve
+        var claimed = UInt64(crafted.count * 8000).littleEndian
+        withUnsafeBytes(of: &claimed) { crafted.replaceSubrange((crafted.count - 16)..<(crafted.count - 8), with: $0) }
+        guard let index = try? Lzip.Index(crafted) else { return XCTAssert(false) }
+        XCTAssert(index.dataSize > 64 << 20)
+        
+        XCTAssertThrowsError(try crafted.lunzipped())
+        XCTAssertThrowsError(try (crafted + crafted).lunzipped(threads: 2))
+        XCTAssertThrowsError(try Array(crafted).lunzipped())
+    }
+    
     static var allTests = [
         ("testSimpleCompression", testSimpleCompression),
+        ("testParallelCompression", testParallelCompression),
+        ("testParallelDecompression", testParallelDecompression),
+        ("testBufferCompression", testBufferCompression),
+        ("testSinkDecompression", testSinkDecompression),
+        ("testMaxCompressedSize", testMaxCompressedSize),
+        ("testContextReuse", testContextReuse),
+        ("testPool", testPool),
+        ("testAdaptiveBufferSize", testAdaptiveBufferSize),
+        ("testFileCompression", testFileCompression),
+        ("testAsyncStreaming", testAsyncStreaming),
+        ("testPushPullStream", testPushPullStream),
+        ("testSyncFlush", testSyncFlush),
+        ("testSeekableRead", testSeekableRead),
+        ("testBatchCompression", testBatchCompression),
+        ("testProgressHandler", testProgressHandler),
+        ("testParameters", testParameters),
+        ("testPrecheck", testPrecheck),
+        ("testDecompressOptions", testDecompressOptions),
+        ("testVerify", testVerify),
+        ("testPipeline", testPipeline),
+        ("testPresetDictionary", testPresetDictionary),
+        ("testAsyncParallelCompression", testAsyncParallelCompression),
+        ("testContiguousBytes", testContiguousBytes),
+        ("testAutoTune", testAutoTune),
+        ("testBoundedDecompression", testBoundedDecompression),
+        ("testInspection", testInspection),
+        ("testArchive", testArchive),
+        ("testCraftedTrailers", testCraftedTrailers),
     ]
 }